@@ -0,0 +1,252 @@
+#include "BitMask.h"
+#include "Parallel.h"
+#include <algorithm>
+
+using namespace app;
+
+BitMask::BitMask(int width, int height) : m_width(width), m_height(height), m_wordsPerRow((width + 63) / 64) {
+	m_words.assign(static_cast<size_t>(m_wordsPerRow) * height, 0);
+}
+
+bool BitMask::Get(int x, int z) const {
+	return (m_words[z * m_wordsPerRow + x / 64] >> (x % 64)) & 1;
+}
+
+void BitMask::Set(int x, int z, bool value) {
+	uint64_t& word = m_words[z * m_wordsPerRow + x / 64];
+	const uint64_t bit = uint64_t(1) << (x % 64);
+	word = value ? word | bit : word & ~bit;
+}
+
+unsigned BitMask::Neighbours(int x, int z) const {
+	const unsigned above = Row3(x, z - 1);
+	const unsigned row = Row3(x, z);
+	const unsigned below = Row3(x, z + 1);
+	return above | ((row & 1) << 3) | ((row >> 2) << 4) | (below << 5);
+}
+
+unsigned BitMask::Row3(int x, int z) const {
+	if (z < 0 || z >= m_height) { return 0; }
+	const uint64_t* row = m_words.data() + z * m_wordsPerRow;
+
+	// the three bits may straddle two words, out of range pixels read as zero
+	const int first = x - 1;
+	unsigned bits;
+	if (first >= 0 && first % 64 <= 61) {
+		bits = static_cast<unsigned>(row[first / 64] >> (first % 64)) & 7u;
+	} else {
+		bits = 0;
+		for (int k = 0; k < 3; k++) {
+			const int px = first + k;
+			if (px >= 0 && px < m_width && ((row[px / 64] >> (px % 64)) & 1)) {
+				bits |= 1u << k;
+			}
+		}
+	}
+	// the padding of the last word is never set, but a pixel past the width must not be read from the next row either
+	if (x + 1 >= m_width) {
+		bits &= 3u;
+	}
+	return bits;
+}
+
+std::vector<int> BitMask::Labels(std::vector<int>& roots) const {
+	const int numPixels = m_width * m_height;
+	const int numStrips = std::clamp(Parallel::NumThreads(), 1, std::max(1, m_height));
+	auto stripBegin = [&](int s) { return static_cast<int>(static_cast<long long>(m_height) * s / numStrips); };
+
+	// parents always point to smaller indices, so the root of a component is its first pixel in row-major order
+	std::vector<int> parent(numPixels, -1);
+	auto find = [&](int i) {
+		while (parent[i] != i) {
+			parent[i] = parent[parent[i]];
+			i = parent[i];
+		}
+		return i;
+	};
+	auto unite = [&](int a, int b) {
+		const int ra = find(a), rb = find(b);
+		if (ra < rb) {
+			parent[rb] = ra;
+		} else if (rb < ra) {
+			parent[ra] = rb;
+		}
+	};
+	// neighbours already scanned, the row above is used only when it belongs to the strip
+	auto uniteScanned = [&](int x, int z, bool withAbove) {
+		const int i = z * m_width + x;
+		if (x > 0 && Get(x - 1, z)) { unite(i, i - 1); }
+		if (!withAbove) { return; }
+		for (int nx = std::max(0, x - 1); nx <= std::min(m_width - 1, x + 1); nx++) {
+			if (Get(nx, z - 1)) { unite(i, i - m_width + nx - x); }
+		}
+	};
+
+	// strips are labeled independently, their unions never leave them
+	Parallel::For(0, numStrips, [&](int s) {
+		for (int z = stripBegin(s); z < stripBegin(s + 1); z++) {
+			for (int x = 0; x < m_width; x++) {
+				if (!Get(x, z)) { continue; }
+				parent[z * m_width + x] = z * m_width + x;
+				uniteScanned(x, z, z > stripBegin(s));
+			}
+		}
+	});
+
+	// first rows of the strips join them with the strips above
+	for (int s = 1; s < numStrips; s++) {
+		const int z = stripBegin(s);
+		for (int x = 0; x < m_width; x++) {
+			if (Get(x, z)) {
+				for (int nx = std::max(0, x - 1); nx <= std::min(m_width - 1, x + 1); nx++) {
+					if (Get(nx, z - 1)) { unite(z * m_width + x, (z - 1) * m_width + nx); }
+				}
+			}
+		}
+	}
+
+	// roots are read without compressing, so the strips can be resolved at the same time
+	std::vector<int> label(numPixels, -1);
+	std::vector<std::vector<int>> stripRoots(numStrips);
+	Parallel::For(0, numStrips, [&](int s) {
+		for (int i = stripBegin(s) * m_width; i < stripBegin(s + 1) * m_width; i++) {
+			if (parent[i] == -1) { continue; }
+			int root = i;
+			while (parent[root] != root) {
+				root = parent[root];
+			}
+			label[i] = root;
+			if (root == i) {
+				stripRoots[s].push_back(i);
+			}
+		}
+	});
+
+	roots.clear();
+	for (const auto& r : stripRoots) {
+		roots.insert(roots.end(), r.begin(), r.end());
+	}
+	return label;
+}
+
+std::vector<BitMask::Component> BitMask::Components() const {
+	const int numStrips = std::clamp(Parallel::NumThreads(), 1, std::max(1, m_height));
+	auto stripBegin = [&](int s) { return static_cast<int>(static_cast<long long>(m_height) * s / numStrips); };
+
+	std::vector<int> roots;
+	const std::vector<int> label = Labels(roots);
+
+	// bounding boxes are gathered per strip and merged
+	std::vector<std::vector<Component>> stripComponents(numStrips);
+	Parallel::For(0, numStrips, [&](int s) {
+		auto& components = stripComponents[s];
+		components.resize(roots.size());
+		for (size_t c = 0; c < roots.size(); c++) {
+			components[c] = { roots[c] % m_width, roots[c] / m_width, m_width, m_height, -1, -1 };
+		}
+		for (int z = stripBegin(s); z < stripBegin(s + 1); z++) {
+			for (int x = 0; x < m_width; x++) {
+				const int l = label[z * m_width + x];
+				if (l == -1) { continue; }
+				auto& c = components[std::lower_bound(roots.begin(), roots.end(), l) - roots.begin()];
+				c.minX = std::min(c.minX, x);
+				c.minZ = std::min(c.minZ, z);
+				c.maxX = std::max(c.maxX, x);
+				c.maxZ = std::max(c.maxZ, z);
+			}
+		}
+	});
+
+	std::vector<Component> components = stripComponents.empty() ? std::vector<Component>() : stripComponents.front();
+	for (int s = 1; s < numStrips; s++) {
+		for (size_t c = 0; c < components.size(); c++) {
+			const auto& other = stripComponents[s][c];
+			components[c].minX = std::min(components[c].minX, other.minX);
+			components[c].minZ = std::min(components[c].minZ, other.minZ);
+			components[c].maxX = std::max(components[c].maxX, other.maxX);
+			components[c].maxZ = std::max(components[c].maxZ, other.maxZ);
+		}
+	}
+	return components;
+}
+
+BitMask BitMask::Thinned(float minExtentShare) const {
+	// Guo-Hall deletion tables of both sub-iterations indexed by the neighbour bits,
+	// unlike Zhang-Suen they keep 2x2 squares and two pixel wide diagonal staircases
+	// p2..p9 go clockwise from the top: bits 1, 2, 4, 7, 6, 5, 3, 0
+	bool removable[2][256];
+	for (unsigned n = 0; n < 256; n++) {
+		const int order[8] = { 1, 2, 4, 7, 6, 5, 3, 0 };
+		bool p[10];
+		for (int k = 0; k < 8; k++) {
+			p[k + 2] = (n >> order[k]) & 1;
+		}
+		const int c = (!p[2] && (p[3] || p[4])) + (!p[4] && (p[5] || p[6])) + (!p[6] && (p[7] || p[8])) + (!p[8] && (p[9] || p[2]));
+		const int n1 = (p[9] || p[2]) + (p[3] || p[4]) + (p[5] || p[6]) + (p[7] || p[8]);
+		const int n2 = (p[2] || p[3]) + (p[4] || p[5]) + (p[6] || p[7]) + (p[8] || p[9]);
+		const int neighbours = std::min(n1, n2);
+		const bool candidate = c == 1 && neighbours >= 2 && neighbours <= 3;
+		removable[0][n] = candidate && !((p[6] || p[7] || !p[9]) && p[8]);
+		removable[1][n] = candidate && !((p[2] || p[3] || !p[5]) && p[4]);
+	}
+
+	BitMask current = *this;
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (int step = 0; step < 2; step++) {
+			// the whole pass reads the mask from before it, rows are written by separate threads
+			BitMask next = current;
+			std::vector<char> rowChanged(m_height, 0);
+			Parallel::For(0, m_height, [&](int z) {
+				for (int x = 0; x < m_width; x++) {
+					if (current.Get(x, z) && removable[step][current.Neighbours(x, z)]) {
+						next.Set(x, z, false);
+						rowChanged[z] = 1;
+					}
+				}
+			});
+			changed = changed || std::find(rowChanged.begin(), rowChanged.end(), 1) != rowChanged.end();
+			current = std::move(next);
+		}
+	}
+
+	// components the skeleton would drop or shrink to a few pixels, like dots and short blobs, keep all their pixels
+	std::vector<int> roots;
+	const std::vector<int> label = Labels(roots);
+	std::vector<int> skeletonPixels(roots.size(), 0);
+	std::vector<int> minX(roots.size(), m_width), maxX(roots.size(), -1);
+	std::vector<int> minZ(roots.size(), m_height), maxZ(roots.size(), -1);
+	auto componentOf = [&](int i) { return std::lower_bound(roots.begin(), roots.end(), label[i]) - roots.begin(); };
+	for (int z = 0; z < m_height; z++) {
+		for (int x = 0; x < m_width; x++) {
+			if (label[z * m_width + x] == -1) { continue; }
+			const auto c = componentOf(z * m_width + x);
+			skeletonPixels[c] += current.Get(x, z);
+			minX[c] = std::min(minX[c], x);
+			maxX[c] = std::max(maxX[c], x);
+			minZ[c] = std::min(minZ[c], z);
+			maxZ[c] = std::max(maxZ[c], z);
+		}
+	}
+
+	std::vector<char> keep(roots.size(), 0);
+	bool anyKept = false;
+	for (size_t c = 0; c < roots.size(); c++) {
+		const int extent = std::max(maxX[c] - minX[c], maxZ[c] - minZ[c]) + 1;
+		if (skeletonPixels[c] <= minExtentShare * extent) {
+			keep[c] = 1;
+			anyKept = true;
+		}
+	}
+	if (anyKept) {
+		for (int z = 0; z < m_height; z++) {
+			for (int x = 0; x < m_width; x++) {
+				if (label[z * m_width + x] != -1 && keep[componentOf(z * m_width + x)]) {
+					current.Set(x, z, true);
+				}
+			}
+		}
+	}
+	return current;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace app {
+	// binary image packed into 64-bit words, rows are stored one after another
+	// the 3x3 neighbourhood of a pixel is read from at most six words instead of eight separate lookups
+	class BitMask {
+	public:
+		// 8-connected group of set pixels, start is its first pixel in row-major order
+		struct Component {
+			int x, z;
+			int minX, minZ, maxX, maxZ;
+		};
+
+		BitMask(int width, int height);
+
+		int Width() const { return m_width; }
+		int Height() const { return m_height; }
+
+		bool Get(int x, int z) const;
+		void Set(int x, int z, bool value);
+
+		// set neighbours as bits in order (-1, -1), (0, -1), (1, -1), (-1, 0), (1, 0), (-1, 1), (0, 1), (1, 1), pixels outside are unset
+		unsigned Neighbours(int x, int z) const;
+
+		// components in row-major order of their starts, labeled with a union-find run in parallel on horizontal strips
+		std::vector<Component> Components() const;
+		// one pixel wide skeleton by Guo-Hall thinning, components stay connected, rows of each pass are processed in parallel
+		// a component whose skeleton is not longer than the share of its larger side keeps all its pixels
+		BitMask Thinned(float minExtentShare = 0.5f) const;
+	private:
+		int m_width, m_height;
+		int m_wordsPerRow;
+		std::vector<uint64_t> m_words;
+
+		// root of the component of every set pixel, -1 for the others, roots are sorted
+		std::vector<int> Labels(std::vector<int>& roots) const;
+		// bits of pixels x - 1, x and x + 1 of the row, lowest for x - 1
+		unsigned Row3(int x, int z) const;
+	};
+}
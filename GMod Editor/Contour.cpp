@@ -0,0 +1,36 @@
+#include "Contour.h"
+#include <algorithm>
+
+using namespace app;
+
+Contour::Contour(std::vector<Point2> points, float gridMargin) : m_points(std::move(points)), m_grid(m_points, gridMargin) {
+	if (m_points.empty()) {
+		return;
+	}
+
+	m_min = m_max = m_points.front();
+	for (const Point2& a : m_points) {
+		m_min = { std::min(m_min.x, a.x), std::min(m_min.z, a.z) };
+		m_max = { std::max(m_max.x, a.x), std::max(m_max.z, a.z) };
+	}
+}
+
+size_t Contour::Extreme(const Point2& direction) const {
+	size_t best = 0;
+	for (size_t k = 1; k < m_points.size(); k++) {
+		if (m_points[k].x * direction.x + m_points[k].z * direction.z > m_points[best].x * direction.x + m_points[best].z * direction.z) {
+			best = k;
+		}
+	}
+	return best;
+}
+
+Contour::Range Contour::Forward(size_t first, size_t last) const {
+	const size_t n = m_points.size();
+	return Range(first, (last + n - first) % n + 1, n, true);
+}
+
+Contour::Range Contour::Backward(size_t first, size_t last) const {
+	const size_t n = m_points.size();
+	return Range(first, (first + n - last) % n + 1, n, false);
+}
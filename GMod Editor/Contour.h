@@ -0,0 +1,61 @@
+#pragma once
+#include "Geometry2D.h"
+#include "SegmentGrid.h"
+#include <cstddef>
+#include <vector>
+
+namespace app {
+	// closed polyline walked by the path stages, point k is joined with point (k + 1) % n
+	// bounds and the segment grid are computed once,
+	// ranges of points are walked by index without copying them or wrapping indices by hand
+	class Contour {
+	public:
+		// indices of consecutive points, wrapping around the end of the contour
+		class Range {
+		public:
+			class Iterator {
+			public:
+				Iterator(const Range& range, size_t step) : m_range(range), m_step(step) {}
+
+				size_t operator*() const { return m_range.At(m_step); }
+				Iterator& operator++() { m_step++; return *this; }
+				bool operator!=(const Iterator& other) const { return m_step != other.m_step; }
+			private:
+				const Range& m_range;
+				size_t m_step;
+			};
+
+			Range(size_t first, size_t count, size_t size, bool forward) : m_first(first), m_count(count), m_size(size), m_forward(forward) {}
+
+			Iterator begin() const { return Iterator(*this, 0); }
+			Iterator end() const { return Iterator(*this, m_count); }
+			size_t Size() const { return m_count; }
+			size_t At(size_t step) const { return m_forward ? (m_first + step) % m_size : (m_first + m_size - step) % m_size; }
+		private:
+			size_t m_first, m_count, m_size;
+			bool m_forward;
+		};
+
+		// grid margin grows the boxes of the segments, queries closer than it to a segment find it
+		Contour(std::vector<Point2> points, float gridMargin);
+
+		size_t Size() const { return m_points.size(); }
+		const Point2& operator[](size_t k) const { return m_points[k]; }
+		const std::vector<Point2>& Points() const { return m_points; }
+
+		const Point2& Min() const { return m_min; }
+		const Point2& Max() const { return m_max; }
+		// point lying furthest along the direction
+		size_t Extreme(const Point2& direction) const;
+
+		const SegmentGrid& Grid() const { return m_grid; }
+
+		// from first to last, both included, going forward or backward and wrapping around the end
+		Range Forward(size_t first, size_t last) const;
+		Range Backward(size_t first, size_t last) const;
+	private:
+		std::vector<Point2> m_points;
+		Point2 m_min = { 0.f, 0.f }, m_max = { 0.f, 0.f };
+		SegmentGrid m_grid;
+	};
+}
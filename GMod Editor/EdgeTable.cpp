@@ -0,0 +1,56 @@
+#include "EdgeTable.h"
+#include <algorithm>
+
+using namespace app;
+
+EdgeTable::EdgeTable(const std::vector<Point2>& points, float tolerance) : m_points(points), m_tolerance(tolerance) {
+	const int n = m_points.size() < 2 ? 0 : static_cast<int>(m_points.size());
+	m_order.resize(n);
+	for (int k = 0; k < n; k++) {
+		m_order[k] = k;
+	}
+	std::sort(m_order.begin(), m_order.end(), [this](int a, int b) {
+		return MinX(a) < MinX(b);
+	});
+}
+
+std::vector<std::vector<EdgeTable::Crossing>> EdgeTable::Sweep(const std::vector<float>& lines) const {
+	const int n = static_cast<int>(m_points.size());
+	std::vector<std::vector<Crossing>> crossings(lines.size());
+
+	std::vector<int> active;
+	size_t nextEdge = 0;
+	for (size_t l = 0; l < lines.size(); l++) {
+		const float x = lines[l];
+
+		// edges starting before the line enter, edges ending before it leave
+		while (nextEdge < m_order.size() && MinX(m_order[nextEdge]) - m_tolerance <= x) {
+			active.push_back(m_order[nextEdge++]);
+		}
+		std::erase_if(active, [&](int edge) { return MaxX(edge) + m_tolerance < x; });
+
+		auto& lineCrossings = crossings[l];
+		for (int edge : active) {
+			const Point2& a = m_points[edge];
+			const Point2& b = m_points[(edge + 1) % n];
+
+			// edges lying along the line cross it at their start
+			const float dx = b.x - a.x;
+			const float t = dx != 0.f ? std::clamp((x - a.x) / dx, 0.f, 1.f) : 0.f;
+			lineCrossings.push_back({ edge, t, a.z + t * (b.z - a.z) });
+		}
+		std::sort(lineCrossings.begin(), lineCrossings.end(), [](const Crossing& c1, const Crossing& c2) {
+			return c1.z < c2.z;
+		});
+	}
+
+	return crossings;
+}
+
+float EdgeTable::MinX(int edge) const {
+	return std::min(m_points[edge].x, m_points[(edge + 1) % m_points.size()].x);
+}
+
+float EdgeTable::MaxX(int edge) const {
+	return std::max(m_points[edge].x, m_points[(edge + 1) % m_points.size()].x);
+}
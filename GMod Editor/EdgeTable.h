@@ -0,0 +1,33 @@
+#pragma once
+#include "Geometry2D.h"
+#include <vector>
+
+namespace app {
+	// edges of a closed polyline sorted by their smallest x, edge k joins points k and (k + 1) % n
+	// vertical scan lines are swept in increasing x with a list of the edges spanning the current line,
+	// so every line sees only the edges it crosses instead of the whole polyline
+	class EdgeTable {
+	public:
+		struct Crossing {
+			int edge;
+			// parameter along the edge, from point k to point k + 1
+			float t;
+			float z;
+		};
+
+		// edges reaching a line within the tolerance count as crossing it
+		EdgeTable(const std::vector<Point2>& points, float tolerance);
+
+		// crossings of every line, lines have to be sorted, crossings of a line are sorted along z
+		std::vector<std::vector<Crossing>> Sweep(const std::vector<float>& lines) const;
+	private:
+		std::vector<Point2> m_points;
+		float m_tolerance;
+
+		// edges in order of increasing smallest x
+		std::vector<int> m_order;
+
+		float MinX(int edge) const;
+		float MaxX(int edge) const;
+	};
+}
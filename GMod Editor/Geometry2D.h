@@ -0,0 +1,17 @@
+#pragma once
+
+namespace app {
+	// point on the XZ plane, contours of the flat stages are handled in it
+	struct Point2 {
+		float x, z;
+	};
+
+	inline Point2 operator-(const Point2& a, const Point2& b) {
+		return { a.x - b.x, a.z - b.z };
+	}
+
+	// z component of the cross product lifted to 3D, positive when b is counterclockwise from a
+	inline float Cross(const Point2& a, const Point2& b) {
+		return a.x * b.z - a.z * b.x;
+	}
+}
@@ -0,0 +1,189 @@
+#include "GougeChecker.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <optional>
+
+using namespace app;
+
+GougeChecker::GougeChecker(const std::vector<const IGeometrical*>& surfaces, int resolution) : m_resolution(resolution) {
+	m_trees.resize(surfaces.size());
+	for (size_t k = 0; k < surfaces.size(); k++) {
+		m_trees[k].surface = surfaces[k];
+	}
+
+	Parallel::For(0, static_cast<int>(m_trees.size()), [&](int k) {
+		Build(m_trees[k]);
+	});
+}
+
+std::vector<GougeChecker::Gouge> GougeChecker::Check(const std::vector<PathParser::MillingCommand>& commands, float radius) const {
+	const float sampleStep = radius / m_samplesPerRadius;
+	const gmod::vector3<float> tipToCentre(0.f, radius, 0.f);
+
+	std::vector<std::optional<Gouge>> found(commands.size());
+	Parallel::For(0, static_cast<int>(commands.size()), [&](int k) {
+		const auto& end = commands[k].coordinates;
+		const auto& start = k > 0 ? commands[k - 1].coordinates : end;
+		const int samples = std::max(1, static_cast<int>(std::ceil((end - start).length() / sampleStep)));
+
+		for (int s = 1; s <= samples; s++) {
+			const gmod::vector3<float> tip = start + (end - start) * (static_cast<float>(s) / samples);
+			const gmod::vector3<float> centre = tip + tipToCentre;
+			const double distance = Distance({ centre.x(), centre.y(), centre.z() }, radius);
+
+			const float depth = static_cast<float>(radius - distance);
+			if (depth > m_tolerance && (!found[k] || depth > found[k]->depth)) {
+				found[k] = Gouge{ commands[k].lineNumber, tip, depth };
+			}
+		}
+	});
+
+	std::vector<Gouge> gouges;
+	for (const auto& gouge : found) {
+		if (gouge) {
+			gouges.push_back(*gouge);
+		}
+	}
+	return gouges;
+}
+
+double GougeChecker::Distance(const gmod::vector3<double>& point, double limit) const {
+	double best = limit;
+	std::vector<int> stack;
+
+	for (const auto& tree : m_trees) {
+		if (tree.nodes.empty()) { continue; }
+
+		// nodes further than the best distance so far cannot hold a closer point
+		stack.assign(1, 0);
+		while (!stack.empty()) {
+			const Node& node = tree.nodes[stack.back()];
+			stack.pop_back();
+			if (BoxDistance(node, point) >= best) { continue; }
+
+			if (node.left == -1) {
+				best = std::min(best, CellDistance(tree, node.i0, node.j0, point));
+			} else {
+				stack.push_back(node.left);
+				stack.push_back(node.right);
+			}
+		}
+	}
+	return best;
+}
+
+void GougeChecker::Build(Tree& tree) const {
+	const int res = m_resolution;
+	tree.bounds = tree.surface->ParametricBounds();
+	tree.du = (tree.bounds.uMax - tree.bounds.uMin) / res;
+	tree.dv = (tree.bounds.vMax - tree.bounds.vMin) / res;
+
+	std::vector<gmod::vector3<double>> samples((res + 1) * (res + 1));
+	for (int i = 0; i <= res; i++) {
+		for (int j = 0; j <= res; j++) {
+			samples[i * (res + 1) + j] = tree.surface->Point(tree.bounds.uMin + i * tree.du, tree.bounds.vMin + j * tree.dv);
+		}
+	}
+
+	// box of a cell spans its corners and its centre, grown by how far the centre bulges out of the corners
+	std::vector<Node> cells(res * res);
+	for (int i = 0; i < res; i++) {
+		for (int j = 0; j < res; j++) {
+			const gmod::vector3<double> corners[4] = {
+				samples[i * (res + 1) + j], samples[(i + 1) * (res + 1) + j],
+				samples[i * (res + 1) + j + 1], samples[(i + 1) * (res + 1) + j + 1]
+			};
+			const auto centre = tree.surface->Point(tree.bounds.uMin + (i + 0.5) * tree.du, tree.bounds.vMin + (j + 0.5) * tree.dv);
+			const double bulge = (centre - (corners[0] + corners[1] + corners[2] + corners[3]) * 0.25).length();
+
+			Node& cell = cells[i * res + j];
+			cell.min = cell.max = centre;
+			for (const auto& c : corners) {
+				cell.min = { std::min(cell.min.x(), c.x()), std::min(cell.min.y(), c.y()), std::min(cell.min.z(), c.z()) };
+				cell.max = { std::max(cell.max.x(), c.x()), std::max(cell.max.y(), c.y()), std::max(cell.max.z(), c.z()) };
+			}
+			const gmod::vector3<double> grow(bulge, bulge, bulge);
+			cell.min = cell.min - grow;
+			cell.max = cell.max + grow;
+		}
+	}
+
+	tree.nodes.reserve(2 * res * res);
+	BuildNode(tree, cells, 0, res, 0, res);
+}
+
+int GougeChecker::BuildNode(Tree& tree, const std::vector<Node>& cells, int i0, int i1, int j0, int j1) const {
+	const int index = static_cast<int>(tree.nodes.size());
+	tree.nodes.push_back(Node{});
+
+	if (i1 - i0 == 1 && j1 - j0 == 1) {
+		Node leaf = cells[i0 * m_resolution + j0];
+		leaf.i0 = i0;
+		leaf.i1 = i1;
+		leaf.j0 = j0;
+		leaf.j1 = j1;
+		tree.nodes[index] = leaf;
+		return index;
+	}
+
+	// the longer side of the range is halved
+	int left, right;
+	if (i1 - i0 >= j1 - j0) {
+		const int mid = (i0 + i1) / 2;
+		left = BuildNode(tree, cells, i0, mid, j0, j1);
+		right = BuildNode(tree, cells, mid, i1, j0, j1);
+	} else {
+		const int mid = (j0 + j1) / 2;
+		left = BuildNode(tree, cells, i0, i1, j0, mid);
+		right = BuildNode(tree, cells, i0, i1, mid, j1);
+	}
+
+	const Node& a = tree.nodes[left];
+	const Node& b = tree.nodes[right];
+	Node& node = tree.nodes[index];
+	node.min = { std::min(a.min.x(), b.min.x()), std::min(a.min.y(), b.min.y()), std::min(a.min.z(), b.min.z()) };
+	node.max = { std::max(a.max.x(), b.max.x()), std::max(a.max.y(), b.max.y()), std::max(a.max.z(), b.max.z()) };
+	node.i0 = i0;
+	node.i1 = i1;
+	node.j0 = j0;
+	node.j1 = j1;
+	node.left = left;
+	node.right = right;
+	return index;
+}
+
+double GougeChecker::CellDistance(const Tree& tree, int i, int j, const gmod::vector3<double>& point) const {
+	const double uMin = tree.bounds.uMin + i * tree.du, uMax = uMin + tree.du;
+	const double vMin = tree.bounds.vMin + j * tree.dv, vMax = vMin + tree.dv;
+
+	// Gauss-Newton steps on |P(u, v) - point|^2
+	// derivatives are central differences, Tangent normalizes them and would drop the parametric speed
+	const double hu = m_derivativeStep * tree.du;
+	const double hv = m_derivativeStep * tree.dv;
+	double u = (uMin + uMax) / 2;
+	double v = (vMin + vMax) / 2;
+	for (int it = 0; it < m_newtonIterations; it++) {
+		const double u0 = std::max(u - hu, tree.bounds.uMin), u1 = std::min(u + hu, tree.bounds.uMax);
+		const double v0 = std::max(v - hv, tree.bounds.vMin), v1 = std::min(v + hv, tree.bounds.vMax);
+		const auto dPu = (tree.surface->Point(u1, v) - tree.surface->Point(u0, v)) * (1.0 / (u1 - u0));
+		const auto dPv = (tree.surface->Point(u, v1) - tree.surface->Point(u, v0)) * (1.0 / (v1 - v0));
+		const auto diff = tree.surface->Point(u, v) - point;
+
+		const double uu = gmod::dot(dPu, dPu), uv = gmod::dot(dPu, dPv), vv = gmod::dot(dPv, dPv);
+		const double det = uu * vv - uv * uv;
+		if (det < 1e-12) { break; }
+		const double gu = gmod::dot(diff, dPu), gv = gmod::dot(diff, dPv);
+
+		u = std::clamp(u - (vv * gu - uv * gv) / det, uMin, uMax);
+		v = std::clamp(v - (uu * gv - uv * gu) / det, vMin, vMax);
+	}
+	return (tree.surface->Point(u, v) - point).length();
+}
+
+double GougeChecker::BoxDistance(const Node& node, const gmod::vector3<double>& point) {
+	const double dx = std::max({ node.min.x() - point.x(), 0.0, point.x() - node.max.x() });
+	const double dy = std::max({ node.min.y() - point.y(), 0.0, point.y() - node.max.y() });
+	const double dz = std::max({ node.min.z() - point.z(), 0.0, point.z() - node.max.z() });
+	return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "IGeometrical.h"
+#include "PathParser.h"
+#include <vector>
+
+namespace app {
+	// checks ball-end tool paths against the surfaces of the model
+	// every surface gets a bounding volume hierarchy over the cells of a parametric grid,
+	// so the nearest distance from a ball centre is searched only in cells whose boxes lie closer than the radius
+	class GougeChecker {
+	public:
+		struct Gouge {
+			int lineNumber;
+			gmod::vector3<float> position; // tool tip
+			float depth;
+		};
+
+		explicit GougeChecker(const std::vector<const IGeometrical*>& surfaces, int resolution = 64);
+
+		// positions of the commands are tool tips, moves between them are sampled
+		// every command moving the ball into a surface is reported once, at its deepest point
+		std::vector<Gouge> Check(const std::vector<PathParser::MillingCommand>& commands, float radius) const;
+		// distance to the nearest surface, limit when none is closer than that
+		double Distance(const gmod::vector3<double>& point, double limit) const;
+	private:
+		// smaller intrusions come from the path precision and are not reported
+		const double m_tolerance = 0.05;
+		const int m_samplesPerRadius = 4;
+		const int m_newtonIterations = 4;
+		// step of the numerical derivatives, relative to the grid cell
+		const double m_derivativeStep = 1e-3;
+
+		// node covers grid cells [i0, i1) x [j0, j1), leaves hold a single cell
+		struct Node {
+			gmod::vector3<double> min, max;
+			int i0, i1, j0, j1;
+			int left = -1, right = -1;
+		};
+
+		struct Tree {
+			const IGeometrical* surface;
+			IGeometrical::UVBounds bounds;
+			double du, dv;
+			std::vector<Node> nodes;
+		};
+		std::vector<Tree> m_trees;
+		int m_resolution;
+
+		void Build(Tree& tree) const;
+		int BuildNode(Tree& tree, const std::vector<Node>& cells, int i0, int i1, int j0, int j1) const;
+		// nearest point of a cell found by Newton steps kept inside it
+		double CellDistance(const Tree& tree, int i, int j, const gmod::vector3<double>& point) const;
+		static double BoxDistance(const Node& node, const gmod::vector3<double>& point);
+	};
+}
@@ -0,0 +1,25 @@
+#include "Heightmap.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace app;
+
+Heightmap::Heightmap(int resX, int resZ, float minX, float minZ, float width, float length, float initialHeight) :
+	m_resX(resX), m_resZ(resZ), m_minX(minX), m_minZ(minZ), m_width(width), m_length(length),
+	m_heights(static_cast<std::size_t>(resX + 1) * (resZ + 1), initialHeight) {}
+
+float Heightmap::Sample(float x, float z) const {
+	const float gx = std::clamp((x - m_minX) / StepX(), 0.f, static_cast<float>(m_resX));
+	const float gz = std::clamp((z - m_minZ) / StepZ(), 0.f, static_cast<float>(m_resZ));
+
+	const int x0 = std::min(static_cast<int>(gx), std::max(m_resX - 1, 0));
+	const int z0 = std::min(static_cast<int>(gz), std::max(m_resZ - 1, 0));
+	const int x1 = std::min(x0 + 1, m_resX);
+	const int z1 = std::min(z0 + 1, m_resZ);
+	const float tx = gx - x0;
+	const float tz = gz - z0;
+
+	const float h0 = At(x0, z0) + (At(x0, z1) - At(x0, z0)) * tz;
+	const float h1 = At(x1, z0) + (At(x1, z1) - At(x1, z0)) * tz;
+	return h0 + (h1 - h0) * tx;
+}
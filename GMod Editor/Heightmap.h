@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+namespace app {
+	// regular grid of heights over the XZ plane, sampled at (resX + 1) x (resZ + 1) points
+	class Heightmap {
+	public:
+		Heightmap() = default;
+		Heightmap(int resX, int resZ, float minX, float minZ, float width, float length, float initialHeight);
+
+		inline int ResX() const { return m_resX; }
+		inline int ResZ() const { return m_resZ; }
+		inline float MinX() const { return m_minX; }
+		inline float MinZ() const { return m_minZ; }
+		inline float Width() const { return m_width; }
+		inline float Length() const { return m_length; }
+		inline float StepX() const { return m_width / m_resX; }
+		inline float StepZ() const { return m_length / m_resZ; }
+
+		// samples are stored in columns of constant x, so walking along z is contiguous
+		inline float& At(int x, int z) { return m_heights[x * (m_resZ + 1) + z]; }
+		inline float At(int x, int z) const { return m_heights[x * (m_resZ + 1) + z]; }
+
+		inline float X(int x) const { return m_minX + x * StepX(); }
+		inline float Z(int z) const { return m_minZ + z * StepZ(); }
+
+		// bilinear interpolation, positions outside of the grid are clamped to its border
+		float Sample(float x, float z) const;
+
+		inline std::vector<float>& Data() { return m_heights; }
+		inline const std::vector<float>& Data() const { return m_heights; }
+	private:
+		int m_resX = 0;
+		int m_resZ = 0;
+		float m_minX = 0.f;
+		float m_minZ = 0.f;
+		float m_width = 0.f;
+		float m_length = 0.f;
+		std::vector<float> m_heights;
+	};
+}
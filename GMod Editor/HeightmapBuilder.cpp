@@ -0,0 +1,209 @@
+#include "HeightmapBuilder.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace app;
+
+void HeightmapBuilder::Rasterize(const std::vector<const IGeometrical*>& surfaces, Heightmap& heightmap) const {
+	// gaps left between triangles of neighbouring quads are never wider than the tolerance,
+	// so growing every triangle by it makes the heightmap watertight
+	const float tolerance = 0.5f * std::min(heightmap.StepX(), heightmap.StepZ());
+
+	std::vector<std::vector<Triangle>> tessellations(surfaces.size());
+	Parallel::For(0, static_cast<int>(surfaces.size()), [&](int i) {
+		tessellations[i] = Tessellate(surfaces[i], tolerance);
+	});
+
+	// bin triangles into tiles of samples, every tile is then rasterized by a single thread
+	const int tilesX = (heightmap.ResX() + m_tileSize) / m_tileSize;
+	const int tilesZ = (heightmap.ResZ() + m_tileSize) / m_tileSize;
+	const float maxX = heightmap.MinX() + heightmap.Width();
+	const float maxZ = heightmap.MinZ() + heightmap.Length();
+
+	std::vector<std::vector<const Triangle*>> tiles(tilesX * tilesZ);
+	for (const auto& triangles : tessellations) {
+		for (const auto& t : triangles) {
+			const float triMinX = std::min({ t.a.x(), t.b.x(), t.c.x() }) - tolerance;
+			const float triMaxX = std::max({ t.a.x(), t.b.x(), t.c.x() }) + tolerance;
+			const float triMinZ = std::min({ t.a.z(), t.b.z(), t.c.z() }) - tolerance;
+			const float triMaxZ = std::max({ t.a.z(), t.b.z(), t.c.z() }) + tolerance;
+			if (triMaxX < heightmap.MinX() || triMinX > maxX || triMaxZ < heightmap.MinZ() || triMinZ > maxZ) { continue; }
+
+			const int x0 = std::clamp(static_cast<int>(std::floor((triMinX - heightmap.MinX()) / heightmap.StepX())), 0, heightmap.ResX()) / m_tileSize;
+			const int x1 = std::clamp(static_cast<int>(std::ceil((triMaxX - heightmap.MinX()) / heightmap.StepX())), 0, heightmap.ResX()) / m_tileSize;
+			const int z0 = std::clamp(static_cast<int>(std::floor((triMinZ - heightmap.MinZ()) / heightmap.StepZ())), 0, heightmap.ResZ()) / m_tileSize;
+			const int z1 = std::clamp(static_cast<int>(std::ceil((triMaxZ - heightmap.MinZ()) / heightmap.StepZ())), 0, heightmap.ResZ()) / m_tileSize;
+
+			for (int tx = x0; tx <= x1; tx++) {
+				for (int tz = z0; tz <= z1; tz++) {
+					tiles[tx * tilesZ + tz].push_back(&t);
+				}
+			}
+		}
+	}
+
+	Parallel::For(0, tilesX * tilesZ, [&](int tile) {
+		const int minX = (tile / tilesZ) * m_tileSize;
+		const int minZ = (tile % tilesZ) * m_tileSize;
+		const int maxX = std::min(minX + m_tileSize - 1, heightmap.ResX());
+		const int maxZ = std::min(minZ + m_tileSize - 1, heightmap.ResZ());
+
+		for (const Triangle* t : tiles[tile]) {
+			RasterizeTriangle(*t, tolerance, minX, maxX, minZ, maxZ, heightmap);
+		}
+	});
+}
+
+std::vector<HeightmapBuilder::Triangle> HeightmapBuilder::Tessellate(const IGeometrical* surface, float tolerance) const {
+	std::vector<Triangle> triangles;
+
+	const auto& bounds = surface->ParametricBounds();
+	const int n = m_initialDivisions;
+	const double du = (bounds.uMax - bounds.uMin) / n;
+	const double dv = (bounds.vMax - bounds.vMin) / n;
+	auto U = [&](int i) { return i == n ? bounds.uMax : bounds.uMin + i * du; };
+	auto V = [&](int j) { return j == n ? bounds.vMax : bounds.vMin + j * dv; };
+
+	// corners of the initial grid are shared between neighbouring quads
+	std::vector<gmod::vector3<double>> grid((n + 1) * (n + 1));
+	for (int i = 0; i <= n; i++) {
+		for (int j = 0; j <= n; j++) {
+			grid[i * (n + 1) + j] = surface->Point(U(i), V(j));
+		}
+	}
+
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < n; j++) {
+			Subdivide(surface, U(i), U(i + 1), V(j), V(j + 1),
+				grid[i * (n + 1) + j], grid[(i + 1) * (n + 1) + j],
+				grid[i * (n + 1) + j + 1], grid[(i + 1) * (n + 1) + j + 1],
+				0, tolerance, triangles);
+		}
+	}
+
+	return triangles;
+}
+
+void HeightmapBuilder::Subdivide(const IGeometrical* surface, double u0, double u1, double v0, double v1,
+	const gmod::vector3<double>& p00, const gmod::vector3<double>& p10,
+	const gmod::vector3<double>& p01, const gmod::vector3<double>& p11,
+	int depth, float tolerance, std::vector<Triangle>& triangles) const {
+	const double um = (u0 + u1) / 2;
+	const double vm = (v0 + v1) / 2;
+
+	const auto pm0 = surface->Point(um, v0);
+	const auto pm1 = surface->Point(um, v1);
+	const auto p0m = surface->Point(u0, vm);
+	const auto p1m = surface->Point(u1, vm);
+	const auto pmm = surface->Point(um, vm);
+
+	// distance between the surface and the bilinear patch spanned by the corners
+	const double error = std::max({
+		(pm0 - (p00 + p10) * 0.5).length(),
+		(pm1 - (p01 + p11) * 0.5).length(),
+		(p0m - (p00 + p01) * 0.5).length(),
+		(p1m - (p10 + p11) * 0.5).length(),
+		(pmm - (p00 + p10 + p01 + p11) * 0.25).length()
+	});
+
+	if (error > tolerance && depth < m_maxDepth) {
+		Subdivide(surface, u0, um, v0, vm, p00, pm0, p0m, pmm, depth + 1, tolerance, triangles);
+		Subdivide(surface, um, u1, v0, vm, pm0, p10, pmm, p1m, depth + 1, tolerance, triangles);
+		Subdivide(surface, u0, um, vm, v1, p0m, pmm, p01, pm1, depth + 1, tolerance, triangles);
+		Subdivide(surface, um, u1, vm, v1, pmm, p1m, pm1, p11, depth + 1, tolerance, triangles);
+		return;
+	}
+
+	// fan around the centre through the edge midpoints, so they match corners of finer neighbours
+	auto toFloat = [](const gmod::vector3<double>& p) {
+		return gmod::vector3<float>(static_cast<float>(p.x()), static_cast<float>(p.y()), static_cast<float>(p.z()));
+	};
+	const gmod::vector3<float> centre = toFloat(pmm);
+	const gmod::vector3<float> ring[8] = {
+		toFloat(p00), toFloat(pm0), toFloat(p10), toFloat(p1m),
+		toFloat(p11), toFloat(pm1), toFloat(p01), toFloat(p0m)
+	};
+	for (int k = 0; k < 8; k++) {
+		triangles.push_back({ centre, ring[k], ring[(k + 1) % 8] });
+	}
+}
+
+void HeightmapBuilder::RasterizeTriangle(const Triangle& t, float margin, int minX, int maxX, int minZ, int maxZ, Heightmap& heightmap) const {
+	const float minY = std::min({ t.a.y(), t.b.y(), t.c.y() });
+	const float maxY = std::max({ t.a.y(), t.b.y(), t.c.y() });
+
+	// restrict the tile to the bounding box of the grown triangle
+	const float boxMinX = std::min({ t.a.x(), t.b.x(), t.c.x() }) - margin;
+	const float boxMaxX = std::max({ t.a.x(), t.b.x(), t.c.x() }) + margin;
+	const float boxMinZ = std::min({ t.a.z(), t.b.z(), t.c.z() }) - margin;
+	const float boxMaxZ = std::max({ t.a.z(), t.b.z(), t.c.z() }) + margin;
+
+	const int x0 = std::max(minX, static_cast<int>(std::ceil((boxMinX - heightmap.MinX()) / heightmap.StepX())));
+	const int x1 = std::min(maxX, static_cast<int>(std::floor((boxMaxX - heightmap.MinX()) / heightmap.StepX())));
+	const int z0 = std::max(minZ, static_cast<int>(std::ceil((boxMinZ - heightmap.MinZ()) / heightmap.StepZ())));
+	const int z1 = std::min(maxZ, static_cast<int>(std::floor((boxMaxZ - heightmap.MinZ()) / heightmap.StepZ())));
+	if (x0 > x1 || z0 > z1) { return; }
+
+	// doubled signed area of pqr in the XZ plane
+	auto edge = [](const gmod::vector3<float>& p, const gmod::vector3<float>& q, float x, float z) {
+		return (q.x() - p.x()) * (z - p.z()) - (q.z() - p.z()) * (x - p.x());
+	};
+
+	const float lenAB = std::hypot(t.b.x() - t.a.x(), t.b.z() - t.a.z());
+	const float lenBC = std::hypot(t.c.x() - t.b.x(), t.c.z() - t.b.z());
+	const float lenCA = std::hypot(t.a.x() - t.c.x(), t.a.z() - t.c.z());
+	const float longest = std::max({ lenAB, lenBC, lenCA });
+	const float area = edge(t.a, t.b, t.c.x(), t.c.z());
+
+	if (std::abs(area) > 1e-6f * longest * longest) {
+		const float sign = area > 0.f ? 1.f : -1.f;
+		for (int x = x0; x <= x1; x++) {
+			const float px = heightmap.X(x);
+			for (int z = z0; z <= z1; z++) {
+				const float pz = heightmap.Z(z);
+				const float wA = sign * edge(t.b, t.c, px, pz);
+				const float wB = sign * edge(t.c, t.a, px, pz);
+				const float wC = sign * edge(t.a, t.b, px, pz);
+
+				// accept samples lying at most the margin outside of every edge
+				if (wA < -margin * lenBC || wB < -margin * lenCA || wC < -margin * lenAB) { continue; }
+
+				// heights extrapolated outside the triangle are kept within its own range
+				const float y = std::clamp((wA * t.a.y() + wB * t.b.y() + wC * t.c.y()) / (sign * area), minY, maxY);
+				float& h = heightmap.At(x, z);
+				if (y > h) {
+					h = y;
+				}
+			}
+		}
+		return;
+	}
+
+	// triangle seen edge-on (vertical walls), rasterize its edges as segments of width 2 * margin
+	const gmod::vector3<float>* segments[3][2] = { { &t.a, &t.b }, { &t.b, &t.c }, { &t.c, &t.a } };
+	for (int x = x0; x <= x1; x++) {
+		const float px = heightmap.X(x);
+		for (int z = z0; z <= z1; z++) {
+			const float pz = heightmap.Z(z);
+			float& h = heightmap.At(x, z);
+			for (const auto& segment : segments) {
+				const auto& p = *segment[0];
+				const auto& q = *segment[1];
+				const float dx = q.x() - p.x();
+				const float dz = q.z() - p.z();
+				const float len2 = dx * dx + dz * dz;
+				const float s = len2 > 0.f ? std::clamp(((px - p.x()) * dx + (pz - p.z()) * dz) / len2, 0.f, 1.f) : 0.f;
+
+				const float distX = px - (p.x() + s * dx);
+				const float distZ = pz - (p.z() + s * dz);
+				if (distX * distX + distZ * distZ > margin * margin) { continue; }
+
+				const float y = p.y() + s * (q.y() - p.y());
+				if (y > h) {
+					h = y;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "Heightmap.h"
+#include "IGeometrical.h"
+#include <vector>
+
+namespace app {
+	// builds heightmaps by tessellating surfaces into triangles and rasterizing them from above
+	class HeightmapBuilder {
+	public:
+		// raises every sample of the heightmap to the highest surface point above it
+		void Rasterize(const std::vector<const IGeometrical*>& surfaces, Heightmap& heightmap) const;
+	private:
+		struct Triangle {
+			gmod::vector3<float> a;
+			gmod::vector3<float> b;
+			gmod::vector3<float> c;
+		};
+
+		const int m_initialDivisions = 8;
+		const int m_maxDepth = 10;
+		const int m_tileSize = 64;
+
+		std::vector<Triangle> Tessellate(const IGeometrical* surface, float tolerance) const;
+		void Subdivide(const IGeometrical* surface, double u0, double u1, double v0, double v1,
+			const gmod::vector3<double>& p00, const gmod::vector3<double>& p10,
+			const gmod::vector3<double>& p01, const gmod::vector3<double>& p11,
+			int depth, float tolerance, std::vector<Triangle>& triangles) const;
+		void RasterizeTriangle(const Triangle& triangle, float margin, int minX, int maxX, int minZ, int maxZ, Heightmap& heightmap) const;
+	};
+}
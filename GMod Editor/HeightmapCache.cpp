@@ -0,0 +1,146 @@
+#include "framework.h"
+#include "HeightmapCache.h"
+#include "IGeometrical.h"
+#include "BSurface.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <Windows.h>
+
+using namespace app;
+
+uint64_t HeightmapCache::Fingerprint(const std::vector<std::unique_ptr<Object>>& sceneObjects) const {
+	uint64_t hash = m_fnvOffset;
+
+	for (const auto& so : sceneObjects) {
+		const IGeometrical* g = dynamic_cast<const IGeometrical*>(so.get());
+		if (g == nullptr) { continue; }
+
+		const auto bounds = g->ParametricBounds();
+		hash = Hash(hash, &bounds, sizeof(bounds));
+
+		// patches are defined by their control points, an edit inside one may not move any lattice sample
+		const Surface* surface = dynamic_cast<const Surface*>(g);
+		if (surface != nullptr) {
+			const int32_t layout[4] = {
+				static_cast<int32_t>(surface->GetSurfaceType()),
+				static_cast<int32_t>(surface->GetAPoints()),
+				static_cast<int32_t>(surface->GetBPoints()),
+				dynamic_cast<const BSurface*>(surface) != nullptr
+			};
+			hash = Hash(hash, layout, sizeof(layout));
+
+			for (const Object* cp : surface->GetControlPoints()) {
+				const auto p = cp->position();
+				const double coords[3] = { p.x(), p.y(), p.z() };
+				hash = Hash(hash, coords, sizeof(coords));
+			}
+			continue;
+		}
+
+		// other surfaces have no control points, they are sampled on a parameter lattice
+		for (int i = 0; i <= m_fingerprintRes; i++) {
+			const double u = bounds.uMin + (bounds.uMax - bounds.uMin) * i / m_fingerprintRes;
+			for (int j = 0; j <= m_fingerprintRes; j++) {
+				const double v = bounds.vMin + (bounds.vMax - bounds.vMin) * j / m_fingerprintRes;
+				const auto p = g->Point(u, v);
+				const double coords[3] = { p.x(), p.y(), p.z() };
+				hash = Hash(hash, coords, sizeof(coords));
+			}
+		}
+	}
+
+	return hash;
+}
+
+uint64_t HeightmapCache::Key(uint64_t fingerprint, std::initializer_list<float> params) const {
+	uint64_t hash = Hash(m_fnvOffset, &fingerprint, sizeof(fingerprint));
+	for (const float param : params) {
+		hash = Hash(hash, &param, sizeof(param));
+	}
+	return hash;
+}
+
+bool HeightmapCache::Load(uint64_t key, Heightmap& heightmap) const {
+	const std::string path = FilePath(key);
+
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	bool loaded = false;
+	LARGE_INTEGER fileSize;
+	HANDLE mapping = nullptr;
+	const void* view = nullptr;
+
+	if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart >= sizeof(FileHeader)) {
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	}
+	if (mapping != nullptr) {
+		view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	}
+	if (view != nullptr) {
+		FileHeader header;
+		std::memcpy(&header, view, sizeof(FileHeader));
+
+		const size_t count = static_cast<size_t>(header.resX + 1) * (header.resZ + 1);
+		const bool valid = header.magic == m_magic && header.version == m_version && header.key == key &&
+			header.resX > 0 && header.resZ > 0 &&
+			static_cast<size_t>(fileSize.QuadPart) == sizeof(FileHeader) + count * sizeof(float);
+
+		if (valid) {
+			heightmap = Heightmap(header.resX, header.resZ, header.minX, header.minZ, header.width, header.length, 0.f);
+			std::memcpy(heightmap.Data().data(), static_cast<const char*>(view) + sizeof(FileHeader), count * sizeof(float));
+			loaded = true;
+		}
+		UnmapViewOfFile(view);
+	}
+	if (mapping != nullptr) {
+		CloseHandle(mapping);
+	}
+	CloseHandle(file);
+
+	return loaded;
+}
+
+void HeightmapCache::Store(uint64_t key, const Heightmap& heightmap) const {
+	std::error_code error;
+	std::filesystem::create_directories(m_directory, error);
+	if (error) { return; }
+
+	// written aside and renamed, so a half written file is never loaded
+	const std::string path = FilePath(key);
+	const std::string tempPath = path + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out) { return; }
+
+		const FileHeader header = {
+			m_magic, m_version, key,
+			heightmap.ResX(), heightmap.ResZ(),
+			heightmap.MinX(), heightmap.MinZ(), heightmap.Width(), heightmap.Length()
+		};
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(heightmap.Data().data()), heightmap.Data().size() * sizeof(float));
+		if (!out) { return; }
+	}
+	std::filesystem::rename(tempPath, path, error);
+}
+
+std::string HeightmapCache::FilePath(uint64_t key) const {
+	std::ostringstream name;
+	name << m_directory << std::hex << std::setw(16) << std::setfill('0') << key << ".hmap";
+	return name.str();
+}
+
+uint64_t HeightmapCache::Hash(uint64_t hash, const void* data, size_t size) const {
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= m_fnvPrime;
+	}
+	return hash;
+}
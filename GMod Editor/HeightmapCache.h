@@ -0,0 +1,44 @@
+#pragma once
+#include "Object.h"
+#include "Heightmap.h"
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+
+namespace app {
+	// heightmaps kept on disk between path generations, keyed by the scene geometry and generation parameters
+	class HeightmapCache {
+	public:
+		// hash of every surface on scene, patch surfaces by the positions of their control points,
+		// other ones sampled at a fixed parameter lattice
+		uint64_t Fingerprint(const std::vector<std::unique_ptr<Object>>& sceneObjects) const;
+		// combines the scene fingerprint with parameters of the heightmap, like its layout and the tool
+		uint64_t Key(uint64_t fingerprint, std::initializer_list<float> params) const;
+
+		bool Load(uint64_t key, Heightmap& heightmap) const;
+		void Store(uint64_t key, const Heightmap& heightmap) const;
+	private:
+		const std::string m_directory = "./cache/";
+		const int m_fingerprintRes = 16;
+
+		static constexpr uint32_t m_magic = 0x434D4847; // "GHMC"
+		static constexpr uint32_t m_version = 2;
+		static constexpr uint64_t m_fnvOffset = 14695981039346656037ull;
+		static constexpr uint64_t m_fnvPrime = 1099511628211ull;
+
+		struct FileHeader {
+			uint32_t magic;
+			uint32_t version;
+			uint64_t key;
+			int32_t resX;
+			int32_t resZ;
+			float minX;
+			float minZ;
+			float width;
+			float length;
+		};
+
+		std::string FilePath(uint64_t key) const;
+		uint64_t Hash(uint64_t hash, const void* data, size_t size) const;
+	};
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace app {
+	class Parallel {
+	public:
+		inline static int NumThreads() {
+			return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+		}
+
+		// calls func(i) for every i in [begin, end)
+		// indices are handed out one by one, so uneven work is balanced between the threads
+		// the first exception thrown by func stops the loop and is rethrown in the calling thread
+		// loops nested inside func run serially on the worker that reached them, the outer loop already uses all threads
+		template<typename F>
+		static void For(int begin, int end, F&& func) {
+			const int count = end - begin;
+			if (count <= 0) { return; }
+
+			const int numThreads = InWorker() ? 1 : std::min(count, NumThreads());
+			if (numThreads == 1) {
+				for (int i = begin; i < end; i++) {
+					func(i);
+				}
+				return;
+			}
+
+			std::atomic<int> next = begin;
+			std::exception_ptr error = nullptr;
+			std::mutex errorMutex;
+
+			auto worker = [&]() {
+				WorkerScope scope;
+				int i;
+				while ((i = next.fetch_add(1)) < end) {
+					try {
+						func(i);
+					} catch (...) {
+						std::lock_guard<std::mutex> lock(errorMutex);
+						if (error == nullptr) {
+							error = std::current_exception();
+						}
+						next = end;
+					}
+				}
+			};
+
+			std::vector<std::thread> threads;
+			threads.reserve(numThreads - 1);
+			for (int t = 0; t < numThreads - 1; t++) {
+				threads.emplace_back(worker);
+			}
+			worker();
+			for (auto& thread : threads) {
+				thread.join();
+			}
+
+			if (error != nullptr) {
+				std::rethrow_exception(error);
+			}
+		}
+
+	private:
+		inline static bool& InWorker() {
+			thread_local bool inWorker = false;
+			return inWorker;
+		}
+
+		// marks the current thread as running a loop body, restores the previous state for the calling thread
+		struct WorkerScope {
+			bool previous;
+			WorkerScope() : previous(InWorker()) { InWorker() = true; }
+			~WorkerScope() { InWorker() = previous; }
+		};
+	};
+}
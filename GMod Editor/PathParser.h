@@ -42,6 +42,7 @@ namespace app {
 		void Clear();
 
 		inline bool Empty() { return m_path.empty(); }
+		inline const std::vector<MillingCommand>& Commands() const { return m_path; }
 
 		struct NextStep {
 			std::vector<gmod::vector3<float>> destinations;
@@ -0,0 +1,224 @@
+#include "PlaneSection.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace app;
+
+PlaneSection::PlaneSection(int resolution, double maxSegment) : m_resolution(resolution), m_maxSegment(maxSegment) {}
+
+std::vector<PlaneSection::Curve> PlaneSection::Section(const IGeometrical* surface, const Plane& plane) const {
+	const int res = m_resolution;
+	const auto bounds = surface->ParametricBounds();
+	const Grid grid = {
+		surface, bounds, surface->IsUClosed(), surface->IsVClosed(),
+		(bounds.uMax - bounds.uMin) / res, (bounds.vMax - bounds.vMin) / res
+	};
+
+	// on closed directions the last sample row is the first one
+	const int nu = grid.uClosed ? res : res + 1;
+	const int nv = grid.vClosed ? res : res + 1;
+
+	std::vector<double> f(nu * nv);
+	for (int i = 0; i < nu; i++) {
+		for (int j = 0; j < nv; j++) {
+			const auto p = surface->Point(grid.bounds.uMin + i * grid.du, grid.bounds.vMin + j * grid.dv);
+			f[i * nv + j] = gmod::dot(plane.normal, p) - plane.d;
+		}
+	}
+	auto value = [&](int i, int j) { return f[i * nv + j]; };
+
+	// edges along u are numbered first, edges along v after them
+	const int numEdgesU = res * nv;
+	auto edgeU = [&](int i, int j) { return j * res + i; };
+	auto edgeV = [&](int i, int j) { return numEdgesU + i * res + j; };
+	const int numEdges = numEdgesU + nu * res;
+
+	// crossings of the plane with the grid edges
+	std::vector<int> crossing(numEdges, -1);
+	std::vector<Point> points;
+	auto addCrossing = [&](int edge, int i0, int j0, int i1, int j1, double u0, double v0, double u1, double v1) {
+		const double f0 = value(i0, j0);
+		const double f1 = value(i1, j1);
+		if ((f0 >= 0) == (f1 >= 0)) { return; }
+		const double t = f0 / (f0 - f1);
+		crossing[edge] = static_cast<int>(points.size());
+		points.push_back(Project(grid, plane, u0 + t * (u1 - u0), v0 + t * (v1 - v0)));
+	};
+
+	for (int j = 0; j < nv; j++) {
+		const double v = grid.bounds.vMin + j * grid.dv;
+		for (int i = 0; i < res; i++) {
+			const double u = grid.bounds.uMin + i * grid.du;
+			addCrossing(edgeU(i, j), i, j, (i + 1) % nu, j, u, v, u + grid.du, v);
+		}
+	}
+	for (int i = 0; i < nu; i++) {
+		const double u = grid.bounds.uMin + i * grid.du;
+		for (int j = 0; j < res; j++) {
+			const double v = grid.bounds.vMin + j * grid.dv;
+			addCrossing(edgeV(i, j), i, j, i, (j + 1) % nv, u, v, u, v + grid.dv);
+		}
+	}
+
+	// marching squares, every cell joins the crossings of its edges in pairs
+	std::vector<std::vector<int>> neighbours(points.size());
+	auto join = [&](int e1, int e2) {
+		neighbours[crossing[e1]].push_back(crossing[e2]);
+		neighbours[crossing[e2]].push_back(crossing[e1]);
+	};
+	for (int i = 0; i < res; i++) {
+		const int i1 = (i + 1) % nu;
+		for (int j = 0; j < res; j++) {
+			const int j1 = (j + 1) % nv;
+
+			// edges in order around the cell, edge k starts at corner k
+			const int edges[4] = { edgeU(i, j), edgeV(i1, j), edgeU(i, j1), edgeV(i, j) };
+			const double corners[4] = { value(i, j), value(i1, j), value(i1, j1), value(i, j1) };
+
+			int crossed[4];
+			int count = 0;
+			for (int k = 0; k < 4; k++) {
+				if (crossing[edges[k]] != -1) {
+					crossed[count++] = k;
+				}
+			}
+
+			if (count == 2) {
+				join(edges[crossed[0]], edges[crossed[1]]);
+			} else if (count == 4) {
+				// saddle, the centre decides which pair of opposite corners is connected
+				const double centre = (corners[0] + corners[1] + corners[2] + corners[3]) / 4;
+				if ((centre >= 0) == (corners[0] >= 0)) {
+					join(edges[0], edges[1]);
+					join(edges[2], edges[3]);
+				} else {
+					join(edges[3], edges[0]);
+					join(edges[1], edges[2]);
+				}
+			}
+		}
+	}
+
+	// chains of crossings, open ones start at the boundary, the remaining ones are loops
+	std::vector<Curve> curves;
+	std::vector<bool> visited(points.size(), false);
+	auto trace = [&](int start, bool closed) {
+		Curve curve = { {}, closed };
+		int prev = -1;
+		int curr = start;
+		while (curr != -1 && !visited[curr]) {
+			visited[curr] = true;
+			curve.points.push_back(points[curr]);
+
+			int next = -1;
+			for (int n : neighbours[curr]) {
+				if (n != prev && !visited[n]) {
+					next = n;
+					break;
+				}
+			}
+			prev = curr;
+			curr = next;
+		}
+		if (curve.points.size() >= 2) {
+			Refine(grid, plane, curve.points, closed);
+			curves.push_back(std::move(curve));
+		}
+	};
+
+	for (int k = 0; k < static_cast<int>(points.size()); k++) {
+		if (!visited[k] && neighbours[k].size() < 2) {
+			trace(k, false);
+		}
+	}
+	for (int k = 0; k < static_cast<int>(points.size()); k++) {
+		if (!visited[k]) {
+			trace(k, true);
+		}
+	}
+
+	return curves;
+}
+
+PlaneSection::Point PlaneSection::Project(const Grid& grid, const Plane& plane, double u, double v) const {
+	const double hu = m_derivativeStep * grid.du;
+	const double hv = m_derivativeStep * grid.dv;
+
+	for (int it = 0; it < m_newtonIterations; it++) {
+		const double dist = gmod::dot(plane.normal, grid.surface->Point(u, v)) - plane.d;
+		if (std::abs(dist) < m_newtonTolerance) { break; }
+
+		// central differences, one-sided at the boundary of open directions
+		double u0 = u - hu, u1 = u + hu, v0 = v - hv, v1 = v + hv;
+		Clamp(grid, u0, v0);
+		Clamp(grid, u1, v1);
+		const double spanU = grid.uClosed ? 2 * hu : u1 - u0;
+		const double spanV = grid.vClosed ? 2 * hv : v1 - v0;
+		const double gu = gmod::dot(plane.normal, grid.surface->Point(u1, v) - grid.surface->Point(u0, v)) / spanU;
+		const double gv = gmod::dot(plane.normal, grid.surface->Point(u, v1) - grid.surface->Point(u, v0)) / spanV;
+		const double g2 = gu * gu + gv * gv;
+		if (g2 < 1e-24) { break; }
+
+		// steps are limited to a cell, so the point stays on the piece of the curve it was found for
+		const double stepU = std::clamp(dist * gu / g2, -grid.du, grid.du);
+		const double stepV = std::clamp(dist * gv / g2, -grid.dv, grid.dv);
+		u -= stepU;
+		v -= stepV;
+		Clamp(grid, u, v);
+	}
+
+	return { u, v, grid.surface->Point(u, v) };
+}
+
+void PlaneSection::Refine(const Grid& grid, const Plane& plane, std::vector<Point>& points, bool closed) const {
+	const double rangeU = grid.bounds.uMax - grid.bounds.uMin;
+	const double rangeV = grid.bounds.vMax - grid.bounds.vMin;
+
+	// midpoint in parameters, the shorter way around closed directions
+	auto middle = [&](const Point& a, const Point& b) {
+		double du = b.u - a.u;
+		double dv = b.v - a.v;
+		if (grid.uClosed && std::abs(du) > rangeU / 2) { du -= std::copysign(rangeU, du); }
+		if (grid.vClosed && std::abs(dv) > rangeV / 2) { dv -= std::copysign(rangeV, dv); }
+		double u = a.u + du / 2;
+		double v = a.v + dv / 2;
+		Clamp(grid, u, v);
+		return Project(grid, plane, u, v);
+	};
+
+	std::vector<Point> refined;
+	refined.reserve(points.size());
+	auto split = [&](auto&& self, const Point& a, const Point& b, int depth) -> void {
+		if (depth >= m_maxRefinements || (b.pos - a.pos).length() <= m_maxSegment) { return; }
+		const Point mid = middle(a, b);
+		self(self, a, mid, depth + 1);
+		refined.push_back(mid);
+		self(self, mid, b, depth + 1);
+	};
+
+	const size_t n = points.size();
+	const size_t segments = closed ? n : n - 1;
+	for (size_t k = 0; k < n; k++) {
+		refined.push_back(points[k]);
+		if (k < segments) {
+			split(split, points[k], points[(k + 1) % n], 0);
+		}
+	}
+	points = std::move(refined);
+}
+
+void PlaneSection::Clamp(const Grid& grid, double& u, double& v) const {
+	const double rangeU = grid.bounds.uMax - grid.bounds.uMin;
+	const double rangeV = grid.bounds.vMax - grid.bounds.vMin;
+
+	if (grid.uClosed) {
+		u = grid.bounds.uMin + std::fmod(std::fmod(u - grid.bounds.uMin, rangeU) + rangeU, rangeU);
+	} else {
+		u = std::clamp(u, grid.bounds.uMin, grid.bounds.uMax);
+	}
+	if (grid.vClosed) {
+		v = grid.bounds.vMin + std::fmod(std::fmod(v - grid.bounds.vMin, rangeV) + rangeV, rangeV);
+	} else {
+		v = std::clamp(v, grid.bounds.vMin, grid.bounds.vMax);
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "../gmod/vector3.h"
+#include "IGeometrical.h"
+#include <vector>
+
+namespace app {
+	// section of a parametric surface with a plane, n . P(u, v) = d solved for (u, v)
+	// the signed distance is sampled on a parametric grid, contoured by marching squares and projected on the plane with Newton steps
+	// the solver keeps no state, so many sections can be computed in parallel
+	class PlaneSection {
+	public:
+		struct Plane {
+			gmod::vector3<double> normal; // unit length
+			double d;
+		};
+
+		struct Point {
+			double u, v;
+			gmod::vector3<double> pos;
+		};
+
+		// open curves end on the parametric boundary of the surface
+		struct Curve {
+			std::vector<Point> points;
+			bool closed;
+		};
+
+		PlaneSection(int resolution = 128, double maxSegment = 0.1);
+
+		// all curves of the section at once
+		std::vector<Curve> Section(const IGeometrical* surface, const Plane& plane) const;
+	private:
+		const int m_newtonIterations = 10;
+		const double m_newtonTolerance = 1e-6;
+		const int m_maxRefinements = 6;
+		// parametric step of the numerical derivatives, relative to the grid cell
+		const double m_derivativeStep = 1e-3;
+
+		int m_resolution;
+		double m_maxSegment;
+
+		struct Grid {
+			const IGeometrical* surface;
+			IGeometrical::UVBounds bounds;
+			bool uClosed, vClosed;
+			double du, dv;
+		};
+
+		// moves (u, v) along the gradient of the signed distance until the point lies on the plane
+		Point Project(const Grid& grid, const Plane& plane, double u, double v) const;
+		// inserts projected points between neighbours lying further apart than the max segment
+		void Refine(const Grid& grid, const Plane& plane, std::vector<Point>& points, bool closed) const;
+		void Clamp(const Grid& grid, double& u, double& v) const;
+	};
+}
@@ -0,0 +1,460 @@
+#include "PolygonClipper.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+using namespace app;
+
+PolygonClipper::Paths PolygonClipper::Union(const Paths& paths) const {
+	return Execute(paths, {}, Operation::Union);
+}
+
+PolygonClipper::Paths PolygonClipper::Difference(const Paths& subject, const Paths& clip) const {
+	return Execute(subject, clip, Operation::Difference);
+}
+
+PolygonClipper::Paths PolygonClipper::Offset(const Paths& paths, float delta) const {
+	// overlapping inputs are joined first, so only the loops of single offset curves are left to remove
+	const Paths clean = Union(paths);
+	if (delta == 0.f) { return clean; }
+
+	const double step = m_arcTolerance < std::abs(delta) ? 2 * std::acos(1 - m_arcTolerance / std::abs(delta)) : std::numbers::pi / 2;
+
+	// raw offset curves cross themselves at concave corners, their positive winding is the result
+	// dense inputs are thinned first, every concave vertex adds a few crossings to the raw curve
+	Paths raw;
+	raw.reserve(clean.size());
+	for (const Path& cleanPath : clean) {
+		const Path path = Simplify(cleanPath, m_arcTolerance);
+		const int n = static_cast<int>(path.size());
+		Path curve;
+
+		for (int i = 0; i < n; i++) {
+			const Point2& prev = path[(i + n - 1) % n];
+			const Point2& curr = path[i];
+			const Point2& next = path[(i + 1) % n];
+
+			const Point2 dPrev = curr - prev;
+			const Point2 dNext = next - curr;
+			const double lPrev = std::hypot(dPrev.x, dPrev.z);
+			const double lNext = std::hypot(dNext.x, dNext.z);
+			// outward normals of counterclockwise paths point to the right
+			const double nPrevX = dPrev.z / lPrev, nPrevZ = -dPrev.x / lPrev;
+			const double nNextX = dNext.z / lNext, nNextZ = -dNext.x / lNext;
+
+			auto add = [&](double nx, double nz) {
+				curve.push_back({ static_cast<float>(curr.x + nx * delta), static_cast<float>(curr.z + nz * delta) });
+			};
+
+			add(nPrevX, nPrevZ);
+			const double sinTurn = nPrevX * nNextZ - nPrevZ * nNextX;
+			const double cosTurn = nPrevX * nNextX + nPrevZ * nNextZ;
+			if (sinTurn * delta > 0) {
+				// round join on the outer side of the corner
+				const double angle = std::atan2(sinTurn, cosTurn);
+				const int steps = static_cast<int>(std::ceil(std::abs(angle) / step));
+				for (int k = 1; k < steps; k++) {
+					const double a = angle * k / steps;
+					add(nPrevX * std::cos(a) - nPrevZ * std::sin(a), nPrevX * std::sin(a) + nPrevZ * std::cos(a));
+				}
+			} else if (sinTurn * delta < 0) {
+				// offsets of the edges cross near a gentle concave corner, the crossing replaces both ends
+				const double reach = std::abs(delta * sinTurn) / (1 + cosTurn);
+				if (cosTurn > 0 && reach <= 0.5 * std::min(lPrev, lNext)) {
+					curve.pop_back();
+					add((nPrevX + nNextX) / (1 + cosTurn), (nPrevZ + nNextZ) / (1 + cosTurn));
+					continue;
+				}
+				// otherwise going through the corner keeps the loop of the concave side positive
+				curve.push_back(curr);
+			}
+			add(nNextX, nNextZ);
+		}
+
+		raw.push_back(curve);
+	}
+
+	return Union(raw);
+}
+
+PolygonClipper::Path PolygonClipper::Simplify(const Path& path, double tolerance) const {
+	const int n = static_cast<int>(path.size());
+	if (n < 4) { return path; }
+
+	// Douglas-Peucker on the path closed at its first point, every kept span is split at its farthest point
+	std::vector<bool> keep(n + 1, false);
+	keep[0] = keep[n] = true;
+	std::vector<std::pair<int, int>> spans = { { 0, n } };
+	while (!spans.empty()) {
+		const auto [first, last] = spans.back();
+		spans.pop_back();
+
+		const Point2& a = path[first];
+		const Point2& b = path[last % n];
+		const double dx = b.x - a.x, dz = b.z - a.z;
+		const double lengthSq = dx * dx + dz * dz;
+
+		int farthest = -1;
+		double farthestDist = tolerance;
+		for (int i = first + 1; i < last; i++) {
+			const double px = path[i].x - a.x, pz = path[i].z - a.z;
+			double dist;
+			if (lengthSq > 0) {
+				const double t = std::clamp((px * dx + pz * dz) / lengthSq, 0.0, 1.0);
+				dist = std::hypot(px - t * dx, pz - t * dz);
+			} else {
+				dist = std::hypot(px, pz);
+			}
+			if (dist > farthestDist) {
+				farthest = i;
+				farthestDist = dist;
+			}
+		}
+
+		if (farthest != -1) {
+			keep[farthest] = true;
+			spans.push_back({ first, farthest });
+			spans.push_back({ farthest, last });
+		}
+	}
+
+	Path simplified;
+	for (int i = 0; i < n; i++) {
+		if (keep[i]) {
+			simplified.push_back(path[i]);
+		}
+	}
+	return simplified.size() >= 3 ? simplified : path;
+}
+
+double PolygonClipper::Area(const Path& path) {
+	double area = 0;
+	for (size_t i = 0; i < path.size(); i++) {
+		const Point2& curr = path[i];
+		const Point2& next = path[(i + 1) % path.size()];
+		area += static_cast<double>(curr.x) * next.z - static_cast<double>(next.x) * curr.z;
+	}
+	return area / 2;
+}
+
+PolygonClipper::Paths PolygonClipper::Execute(const Paths& subject, const Paths& clip, Operation operation) const {
+	std::vector<Edge> edges;
+	AddEdges(subject, true, edges);
+	AddEdges(clip, false, edges);
+	if (edges.empty()) { return {}; }
+
+	const std::vector<Edge> merged = MergeEdges(SplitEdges(edges));
+	return LinkLoops(SelectBoundary(merged, operation));
+}
+
+void PolygonClipper::AddEdges(const Paths& paths, bool subject, std::vector<Edge>& edges) const {
+	for (const Path& path : paths) {
+		for (size_t i = 0; i < path.size(); i++) {
+			const IntPoint a = ToInt(path[i]);
+			const IntPoint b = ToInt(path[(i + 1) % path.size()]);
+			if (a == b) { continue; }
+			edges.push_back({ a, b, subject ? 1 : 0, subject ? 0 : 1 });
+		}
+	}
+}
+
+std::vector<PolygonClipper::Edge> PolygonClipper::SplitEdges(const std::vector<Edge>& edges) const {
+	const int n = static_cast<int>(edges.size());
+
+	// uniform grid over the bounding boxes of the edges
+	IntPoint min = edges.front().a, max = edges.front().a;
+	double totalSize = 0;
+	for (const Edge& e : edges) {
+		min = { std::min({ min.x, e.a.x, e.b.x }), std::min({ min.z, e.a.z, e.b.z }) };
+		max = { std::max({ max.x, e.a.x, e.b.x }), std::max({ max.z, e.a.z, e.b.z }) };
+		totalSize += static_cast<double>(std::max(std::abs(e.b.x - e.a.x), std::abs(e.b.z - e.a.z)));
+	}
+	const double width = static_cast<double>(max.x - min.x) + 1;
+	const double length = static_cast<double>(max.z - min.z) + 1;
+	const double cellSize = std::max({ m_sizesPerCell * totalSize / n, std::sqrt(width * length / (4.0 * n)), 1.0 });
+	const int cellsX = static_cast<int>(std::ceil(width / cellSize));
+	const int cellsZ = static_cast<int>(std::ceil(length / cellSize));
+
+	auto cellX = [&](int64_t x) { return std::min(cellsX - 1, static_cast<int>((x - min.x) / cellSize)); };
+	auto cellZ = [&](int64_t z) { return std::min(cellsZ - 1, static_cast<int>((z - min.z) / cellSize)); };
+
+	std::vector<std::vector<int>> cells(static_cast<size_t>(cellsX) * cellsZ);
+	for (int k = 0; k < n; k++) {
+		const Edge& e = edges[k];
+		for (int x = cellX(std::min(e.a.x, e.b.x)); x <= cellX(std::max(e.a.x, e.b.x)); x++) {
+			for (int z = cellZ(std::min(e.a.z, e.b.z)); z <= cellZ(std::max(e.a.z, e.b.z)); z++) {
+				cells[x * cellsZ + z].push_back(k);
+			}
+		}
+	}
+
+	auto sign = [](int64_t v) { return (v > 0) - (v < 0); };
+	// p lies on the line of e, checks if it is strictly between its ends
+	auto inside = [](const Edge& e, const IntPoint& p) {
+		const int64_t t = Dot(e.a, e.b, p);
+		return t > 0 && t < Dot(e.a, e.b, e.b);
+	};
+
+	// pairs are tested in the cell holding the lowest corner of the overlap of their boxes, so only once
+	std::vector<std::vector<IntPoint>> splits(n);
+	for (int c = 0; c < static_cast<int>(cells.size()); c++) {
+		const auto& cell = cells[c];
+		for (size_t p = 0; p < cell.size(); p++) {
+			for (size_t q = p + 1; q < cell.size(); q++) {
+				const int i = cell[p], j = cell[q];
+				const Edge& e1 = edges[i];
+				const Edge& e2 = edges[j];
+
+				const int64_t overlapX = std::max(std::min(e1.a.x, e1.b.x), std::min(e2.a.x, e2.b.x));
+				const int64_t overlapZ = std::max(std::min(e1.a.z, e1.b.z), std::min(e2.a.z, e2.b.z));
+				if (overlapX > std::min(std::max(e1.a.x, e1.b.x), std::max(e2.a.x, e2.b.x)) ||
+					overlapZ > std::min(std::max(e1.a.z, e1.b.z), std::max(e2.a.z, e2.b.z)) ||
+					cellX(overlapX) * cellsZ + cellZ(overlapZ) != c) {
+					continue;
+				}
+
+				const int o1 = sign(Cross(e1.a, e1.b, e2.a));
+				const int o2 = sign(Cross(e1.a, e1.b, e2.b));
+				const int o3 = sign(Cross(e2.a, e2.b, e1.a));
+				const int o4 = sign(Cross(e2.a, e2.b, e1.b));
+
+				if (o1 * o2 < 0 && o3 * o4 < 0) {
+					// proper crossing, rounded to the grid
+					const double d = static_cast<double>(Cross({ 0, 0 }, { e1.b.x - e1.a.x, e1.b.z - e1.a.z }, { e2.b.x - e2.a.x, e2.b.z - e2.a.z }));
+					const double t = static_cast<double>(Cross({ 0, 0 }, { e2.a.x - e1.a.x, e2.a.z - e1.a.z }, { e2.b.x - e2.a.x, e2.b.z - e2.a.z })) / d;
+					const IntPoint cross = {
+						e1.a.x + std::llround(t * (e1.b.x - e1.a.x)),
+						e1.a.z + std::llround(t * (e1.b.z - e1.a.z))
+					};
+					splits[i].push_back(cross);
+					splits[j].push_back(cross);
+					continue;
+				}
+
+				// touchings and collinear overlaps split the edges at the ends lying on the other one
+				if (o1 == 0 && inside(e1, e2.a)) { splits[i].push_back(e2.a); }
+				if (o2 == 0 && inside(e1, e2.b)) { splits[i].push_back(e2.b); }
+				if (o3 == 0 && inside(e2, e1.a)) { splits[j].push_back(e1.a); }
+				if (o4 == 0 && inside(e2, e1.b)) { splits[j].push_back(e1.b); }
+			}
+		}
+	}
+
+	std::vector<Edge> result;
+	result.reserve(n);
+	for (int k = 0; k < n; k++) {
+		const Edge& e = edges[k];
+		auto& points = splits[k];
+		std::sort(points.begin(), points.end(), [&e](const IntPoint& p, const IntPoint& q) {
+			return Dot(e.a, e.b, p) < Dot(e.a, e.b, q);
+		});
+
+		IntPoint from = e.a;
+		for (const IntPoint& p : points) {
+			if (p == from || p == e.b) { continue; }
+			result.push_back({ from, p, e.subject, e.clip });
+			from = p;
+		}
+		result.push_back({ from, e.b, e.subject, e.clip });
+	}
+	return result;
+}
+
+std::vector<PolygonClipper::Edge> PolygonClipper::MergeEdges(std::vector<Edge> edges) const {
+	for (Edge& e : edges) {
+		if (e.b < e.a) {
+			std::swap(e.a, e.b);
+			e.subject = -e.subject;
+			e.clip = -e.clip;
+		}
+	}
+	std::sort(edges.begin(), edges.end(), [](const Edge& e1, const Edge& e2) {
+		return e1.a < e2.a || (e1.a == e2.a && e1.b < e2.b);
+	});
+
+	// edges cancelling each other out change no winding and bound nothing
+	std::vector<Edge> merged;
+	for (const Edge& e : edges) {
+		if (!merged.empty() && merged.back().a == e.a && merged.back().b == e.b) {
+			merged.back().subject += e.subject;
+			merged.back().clip += e.clip;
+		} else {
+			if (!merged.empty() && merged.back().subject == 0 && merged.back().clip == 0) {
+				merged.pop_back();
+			}
+			merged.push_back(e);
+		}
+	}
+	if (!merged.empty() && merged.back().subject == 0 && merged.back().clip == 0) {
+		merged.pop_back();
+	}
+	return merged;
+}
+
+std::vector<PolygonClipper::Edge> PolygonClipper::SelectBoundary(const std::vector<Edge>& edges, Operation operation) const {
+	const int n = static_cast<int>(edges.size());
+	if (n == 0) { return {}; }
+
+	// windings are found by casting rays along +x from the doubled midpoints of the edges
+	// horizontal slabs keep the edges spanning them, a ray crosses only edges of its slab
+	int64_t minZ = edges.front().a.z, maxZ = minZ;
+	double totalHeight = 0;
+	for (const Edge& e : edges) {
+		minZ = std::min({ minZ, e.a.z, e.b.z });
+		maxZ = std::max({ maxZ, e.a.z, e.b.z });
+		totalHeight += static_cast<double>(std::abs(e.b.z - e.a.z));
+	}
+	const double slabHeight = std::max({ m_sizesPerCell * totalHeight / n, static_cast<double>(maxZ - minZ + 1) / n, 1.0 });
+	const int numSlabs = std::max(1, static_cast<int>(std::ceil((maxZ - minZ + 1) / slabHeight)));
+	auto slab = [&](int64_t z) { return std::min(numSlabs - 1, static_cast<int>((z - minZ) / slabHeight)); };
+
+	std::vector<std::vector<int>> slabs(numSlabs);
+	for (int k = 0; k < n; k++) {
+		for (int s = slab(std::min(edges[k].a.z, edges[k].b.z)); s <= slab(std::max(edges[k].a.z, edges[k].b.z)); s++) {
+			slabs[s].push_back(k);
+		}
+	}
+
+	auto isInside = [operation](int subject, int clip) {
+		return operation == Operation::Union ? subject > 0 : subject > 0 && clip <= 0;
+	};
+
+	std::vector<char> kept(n, 0); // 1 - along a -> b, -1 - reversed
+	Parallel::For(0, n, [&](int k) {
+		const Edge& e = edges[k];
+		const IntPoint m = { e.a.x + e.b.x, e.a.z + e.b.z };
+
+		// windings of the side towards +x, or towards +z for horizontal edges, other edges meet e only at its ends
+		// the half-open rule takes points at the height of a vertex as lying just above it
+		int subject = 0, clip = 0;
+		for (const int h : slabs[slab(m.z / 2)]) {
+			if (h == k) { continue; }
+			const Edge& f = edges[h];
+			const IntPoint a = { 2 * f.a.x, 2 * f.a.z };
+			const IntPoint b = { 2 * f.b.x, 2 * f.b.z };
+
+			if (a.z <= m.z && m.z < b.z && Cross(a, b, m) > 0) {
+				subject += f.subject;
+				clip += f.clip;
+			} else if (b.z <= m.z && m.z < a.z && Cross(a, b, m) < 0) {
+				subject -= f.subject;
+				clip -= f.clip;
+			}
+		}
+
+		// the left side winds more by the contribution of e, it is the side found for edges going down or horizontally
+		int leftSubject = subject, leftClip = clip;
+		int rightSubject = subject, rightClip = clip;
+		if (e.a.z < e.b.z) {
+			leftSubject += e.subject;
+			leftClip += e.clip;
+		} else {
+			rightSubject -= e.subject;
+			rightClip -= e.clip;
+		}
+
+		const bool left = isInside(leftSubject, leftClip);
+		const bool right = isInside(rightSubject, rightClip);
+		if (left != right) {
+			kept[k] = left ? 1 : -1;
+		}
+	});
+
+	std::vector<Edge> boundary;
+	for (int k = 0; k < n; k++) {
+		if (kept[k] == 1) {
+			boundary.push_back({ edges[k].a, edges[k].b, 1, 0 });
+		} else if (kept[k] == -1) {
+			boundary.push_back({ edges[k].b, edges[k].a, 1, 0 });
+		}
+	}
+	return boundary;
+}
+
+PolygonClipper::Paths PolygonClipper::LinkLoops(const std::vector<Edge>& boundary) const {
+	const int n = static_cast<int>(boundary.size());
+
+	std::vector<int> order(n);
+	for (int k = 0; k < n; k++) {
+		order[k] = k;
+	}
+	std::sort(order.begin(), order.end(), [&boundary](int i, int j) {
+		return boundary[i].a < boundary[j].a;
+	});
+
+	std::vector<bool> used(n, false);
+	Paths loops;
+	for (int first : order) {
+		if (used[first]) { continue; }
+
+		std::vector<IntPoint> loop;
+		const IntPoint start = boundary[first].a;
+		int curr = first;
+		used[curr] = true;
+		while (true) {
+			loop.push_back(boundary[curr].a);
+			const IntPoint v = boundary[curr].b;
+			if (v == start) { break; }
+
+			// the next edge is the first one clockwise from the way back, so loops touching at a vertex stay apart
+			const IntPoint back = boundary[curr].a;
+			const auto begin = std::lower_bound(order.begin(), order.end(), v, [&boundary](int k, const IntPoint& p) {
+				return boundary[k].a < p;
+			});
+			const auto end = std::upper_bound(begin, order.end(), v, [&boundary](const IntPoint& p, int k) {
+				return p < boundary[k].a;
+			});
+
+			int next = -1;
+			double bestAngle = 0;
+			for (auto it = begin; it != end; ++it) {
+				if (used[*it]) { continue; }
+				const IntPoint to = boundary[*it].b;
+				double angle = -std::atan2(static_cast<double>(Cross(v, back, to)), static_cast<double>(Dot(v, back, to)));
+				if (angle <= 0) {
+					angle += 2 * std::numbers::pi;
+				}
+				if (next == -1 || angle < bestAngle) {
+					next = *it;
+					bestAngle = angle;
+				}
+			}
+			if (next == -1) { break; }
+
+			curr = next;
+			used[curr] = true;
+		}
+
+		// points splitting straight edges are not needed anymore
+		Path path;
+		const int m = static_cast<int>(loop.size());
+		for (int i = 0; i < m; i++) {
+			const IntPoint& prev = loop[(i + m - 1) % m];
+			const IntPoint& next = loop[(i + 1) % m];
+			if (Cross(prev, loop[i], next) != 0 || Dot(loop[i], prev, next) >= 0) {
+				path.push_back(ToFloat(loop[i]));
+			}
+		}
+		if (path.size() >= 3) {
+			loops.push_back(path);
+		}
+	}
+	return loops;
+}
+
+PolygonClipper::IntPoint PolygonClipper::ToInt(const Point2& p) const {
+	return { std::llround(p.x * m_scale), std::llround(p.z * m_scale) };
+}
+
+Point2 PolygonClipper::ToFloat(const IntPoint& p) const {
+	return { static_cast<float>(p.x / m_scale), static_cast<float>(p.z / m_scale) };
+}
+
+int64_t PolygonClipper::Cross(const IntPoint& o, const IntPoint& a, const IntPoint& b) {
+	return (a.x - o.x) * (b.z - o.z) - (a.z - o.z) * (b.x - o.x);
+}
+
+int64_t PolygonClipper::Dot(const IntPoint& o, const IntPoint& a, const IntPoint& b) {
+	return (a.x - o.x) * (b.x - o.x) + (a.z - o.z) * (b.z - o.z);
+}
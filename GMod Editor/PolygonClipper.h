@@ -0,0 +1,69 @@
+#pragma once
+#include "Geometry2D.h"
+#include <cstdint>
+#include <vector>
+
+namespace app {
+	// boolean operations and offsetting of polygons on the XZ plane
+	// coordinates are snapped to a fixed-point grid, so every predicate is evaluated exactly on integers
+	// outer boundaries are counterclockwise (positive Area) and holes clockwise, results follow the same rule
+	class PolygonClipper {
+	public:
+		using Path = std::vector<Point2>;
+		using Paths = std::vector<Path>;
+
+		// region of positive winding of all the paths
+		Paths Union(const Paths& paths) const;
+		// region of positive winding of the subject and non-positive winding of the clip
+		Paths Difference(const Paths& subject, const Paths& clip) const;
+		// union of the paths grown by delta with round joins, negative delta shrinks them
+		Paths Offset(const Paths& paths, float delta) const;
+
+		// positive for counterclockwise paths
+		static double Area(const Path& path);
+	private:
+		// fixed-point units per scene unit
+		const double m_scale = 1e4;
+		// largest distance of a round join from its polygonal approximation, in scene units
+		const double m_arcTolerance = 0.01;
+		// side of a grid cell or height of a slab in average edge sizes
+		const int m_sizesPerCell = 2;
+
+		struct IntPoint {
+			int64_t x, z;
+
+			bool operator==(const IntPoint& other) const { return x == other.x && z == other.z; }
+			bool operator<(const IntPoint& other) const { return x < other.x || (x == other.x && z < other.z); }
+		};
+
+		// contributions of the edge to the winding of the subject and of the clip, counted along a -> b
+		struct Edge {
+			IntPoint a, b;
+			int subject, clip;
+		};
+
+		enum class Operation {
+			Union, Difference
+		};
+
+		Paths Execute(const Paths& subject, const Paths& clip, Operation operation) const;
+
+		void AddEdges(const Paths& paths, bool subject, std::vector<Edge>& edges) const;
+		// splits the edges at every crossing and touching, so they meet only at their ends
+		std::vector<Edge> SplitEdges(const std::vector<Edge>& edges) const;
+		// joins equal edges into one, directed from the smaller end to the greater one
+		std::vector<Edge> MergeEdges(std::vector<Edge> edges) const;
+		// keeps the edges separating the result from the rest of the plane, with the result on their left
+		std::vector<Edge> SelectBoundary(const std::vector<Edge>& edges, Operation operation) const;
+		Paths LinkLoops(const std::vector<Edge>& boundary) const;
+		// drops points closer than the tolerance to the simplified closed path
+		Path Simplify(const Path& path, double tolerance) const;
+
+		IntPoint ToInt(const Point2& p) const;
+		Point2 ToFloat(const IntPoint& p) const;
+
+		// (a - o) x (b - o) and (a - o) . (b - o), exact for coordinates up to 2^30
+		static int64_t Cross(const IntPoint& o, const IntPoint& a, const IntPoint& b);
+		static int64_t Dot(const IntPoint& o, const IntPoint& a, const IntPoint& b);
+	};
+}
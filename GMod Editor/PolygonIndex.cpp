@@ -0,0 +1,100 @@
+#include "PolygonIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace app;
+
+PolygonIndex::PolygonIndex(const std::vector<Point2>& points) : m_points(points) {
+	const int n = static_cast<int>(m_points.size());
+	if (n < 3) {
+		m_starts.assign(2, 0);
+		return;
+	}
+
+	float maxZ = m_points.front().z;
+	m_minZ = maxZ;
+	double totalHeight = 0;
+	for (int k = 0; k < n; k++) {
+		const Point2& a = m_points[k];
+		const Point2& b = m_points[(k + 1) % n];
+		m_minZ = std::min(m_minZ, a.z);
+		maxZ = std::max(maxZ, a.z);
+		totalHeight += std::abs(b.z - a.z);
+	}
+
+	// at most one slab per edge, polygons with a few tall edges do not need more
+	const float extent = maxZ - m_minZ;
+	m_slabHeight = std::max({ m_heightsPerSlab * static_cast<float>(totalHeight / n), extent / n, std::numeric_limits<float>::min() });
+	m_numSlabs = std::clamp(static_cast<int>(std::ceil(extent / m_slabHeight)), 1, n);
+
+	// counting sort of the edges into slabs, first pass counts, second one fills
+	auto slabs = [&](int k) {
+		const float z1 = m_points[k].z;
+		const float z2 = m_points[(k + 1) % n].z;
+		return std::make_pair(Slab(std::min(z1, z2)), Slab(std::max(z1, z2)));
+	};
+
+	m_starts.assign(m_numSlabs + 1, 0);
+	for (int k = 0; k < n; k++) {
+		const auto [first, last] = slabs(k);
+		for (int s = first; s <= last; s++) {
+			m_starts[s + 1]++;
+		}
+	}
+	for (int s = 0; s < m_numSlabs; s++) {
+		m_starts[s + 1] += m_starts[s];
+	}
+
+	m_edges.resize(m_starts.back());
+	std::vector<int> fill(m_starts.begin(), m_starts.end() - 1);
+	for (int k = 0; k < n; k++) {
+		const auto [first, last] = slabs(k);
+		for (int s = first; s <= last; s++) {
+			m_edges[fill[s]++] = k;
+		}
+	}
+}
+
+int PolygonIndex::Winding(const Point2& point) const {
+	const int n = static_cast<int>(m_points.size());
+	if (n < 3) { return 0; }
+
+	// only edges spanning point.z may count, all of them share its slab
+	const int slab = Slab(point.z);
+	int winding = 0;
+	for (int e = m_starts[slab]; e < m_starts[slab + 1]; e++) {
+		const int i = m_edges[e];
+		const Point2& vi = m_points[i];
+		const Point2& vj = m_points[(i + 1) % n];
+
+		float cross = (vj.x - vi.x) * (point.z - vi.z) - (vj.z - vi.z) * (point.x - vi.x);
+
+		// check if edge crosses upward
+		if (vi.z < point.z) {
+			if (vj.z > point.z && cross > 0) {
+				winding++;
+			}
+		}
+		// check if edge crosses downward
+		else {
+			if (vj.z < point.z && cross < 0) {
+				winding--;
+			}
+		}
+	}
+	return winding;
+}
+
+std::vector<int> PolygonIndex::Windings(const std::vector<Point2>& points) const {
+	std::vector<int> windings(points.size());
+	for (size_t i = 0; i < points.size(); i++) {
+		windings[i] = Winding(points[i]);
+	}
+	return windings;
+}
+
+int PolygonIndex::Slab(float z) const {
+	const float slab = std::floor((z - m_minZ) / m_slabHeight);
+	return static_cast<int>(std::clamp(slab, 0.f, static_cast<float>(m_numSlabs - 1)));
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "Geometry2D.h"
+#include <vector>
+
+namespace app {
+	// closed polygon split into horizontal slabs of constant z, every slab keeps the edges spanning it
+	// a horizontal ray from a point crosses only edges of the slab containing it,
+	// so the winding number is found without walking the whole polygon
+	class PolygonIndex {
+	public:
+		explicit PolygonIndex(const std::vector<Point2>& points);
+
+		// same crossing rule as a loop over all edges, points on the boundary follow it as well
+		int Winding(const Point2& point) const;
+		// windings of many points, one slab lookup each
+		std::vector<int> Windings(const std::vector<Point2>& points) const;
+	private:
+		// height of a slab in average edge heights, a typical edge spans one or two slabs
+		const float m_heightsPerSlab = 2.f;
+
+		std::vector<Point2> m_points;
+		float m_minZ = 0.f;
+		float m_slabHeight = 1.f;
+		int m_numSlabs = 1;
+
+		// edges of slab s are m_edges[m_starts[s] .. m_starts[s + 1]), edge k joins points k and (k + 1) % n
+		std::vector<int> m_starts;
+		std::vector<int> m_edges;
+
+		int Slab(float z) const;
+	};
+}
@@ -1,5 +1,5 @@
 #include "SegmentGraph.h"
-#include <set>
+#include <unordered_set>
 #include <stack>
 #include <algorithm>
 
@@ -8,7 +8,13 @@ using namespace app;
 SegmentGraph::SegmentGraph(const std::vector<std::pair<float, std::vector<Segment2>>>& verticalSegments,
 	const std::vector<Segment2>& contourSegments, int vertNum) {
 
-	vertices2 = std::vector<Vertex2>(vertNum);
+	vertices2 = std::vector<SegmentEnd2>(vertNum);
+	std::unordered_set<long long> added;
+	auto addEdge = [&](const SegmentEnd2& from, const Edge2& edge) {
+		vertices2[edge.v1] = from;
+		m_edges2.push_back(edge);
+		added.insert(Key(edge.v1, edge.v2, vertNum));
+	};
 
 	// add vertical edges
 	for (const auto& [xVal, segments] : verticalSegments) {
@@ -17,12 +23,9 @@ SegmentGraph::SegmentGraph(const std::vector<std::pair<float, std::vector<Segmen
 
 			int v1 = seg.p1.id;
 			int v2 = seg.p2.id;
-		
-			vertices2[v1].segEnd = seg.p1;
-			vertices2[v1].neighbours.push_back(std::make_pair(v2, Edge2{ seg, v1, v2, diffZ, true, false }));
-			
-			vertices2[v2].segEnd = seg.p2;
-			vertices2[v2].neighbours.push_back(std::make_pair(v1, Edge2{ seg, v2, v1, diffZ, true, false }));
+
+			addEdge(seg.p1, Edge2{ seg, v1, v2, diffZ, true, false });
+			addEdge(seg.p2, Edge2{ seg, v2, v1, diffZ, true, false });
 		}
 	}
 
@@ -35,22 +38,11 @@ SegmentGraph::SegmentGraph(const std::vector<std::pair<float, std::vector<Segmen
 		int v1 = seg.p1.id;
 		int v2 = seg.p2.id;
 
-		auto end1 = vertices2[v1].neighbours.end();
-		auto it1 = std::find_if(vertices2[v1].neighbours.begin(), end1, [&v2](const std::pair<int, Edge2>& el) {
-			return el.first == v2;
-		});
-		if (it1 == end1) {
-			vertices2[v1].segEnd = seg.p1;
-			vertices2[v1].neighbours.push_back(std::make_pair(v2, Edge2{ seg, v1, v2, dist, false, false }));
+		if (!added.contains(Key(v1, v2, vertNum))) {
+			addEdge(seg.p1, Edge2{ seg, v1, v2, dist, false, false });
 		}
-
-		auto end2 = vertices2[v2].neighbours.end();
-		auto it2 = std::find_if(vertices2[v2].neighbours.begin(), end2, [&v1](const std::pair<int, Edge2>& el) {
-			return el.first == v1;
-		});
-		if (it2 == end2) {
-			vertices2[v2].segEnd = seg.p2;
-			vertices2[v2].neighbours.push_back(std::make_pair(v1, Edge2{ seg, v2, v1, dist, false, false }));
+		if (!added.contains(Key(v2, v1, vertNum))) {
+			addEdge(seg.p2, Edge2{ seg, v2, v1, dist, false, false });
 		}
 	}
 
@@ -65,11 +57,8 @@ SegmentGraph::SegmentGraph(const std::vector<std::pair<float, std::vector<Segmen
 		int v2Top = rightTop.id;
 		Segment2 topSeg(leftTop, rightTop);
 
-		vertices2[v1Top].segEnd = leftTop;
-		vertices2[v2Top].segEnd = rightTop;
-
-		vertices2[v1Top].neighbours.push_back(std::make_pair(v2Top, Edge2{ topSeg, v1Top, v2Top, diffX, false, true }));
-		vertices2[v2Top].neighbours.push_back(std::make_pair(v1Top, Edge2{ topSeg, v2Top, v1Top, diffX, false, true }));
+		addEdge(leftTop, Edge2{ topSeg, v1Top, v2Top, diffX, false, true });
+		addEdge(rightTop, Edge2{ topSeg, v2Top, v1Top, diffX, false, true });
 
 		auto& leftBottom = verticalSegments[i].second.back().p2;
 		auto& rightBottom = verticalSegments[i + 1].second.back().p2;
@@ -78,54 +67,131 @@ SegmentGraph::SegmentGraph(const std::vector<std::pair<float, std::vector<Segmen
 		int v2Bottom = rightBottom.id;
 		Segment2 bottomSeg(leftBottom, rightBottom);
 
-		vertices2[v1Bottom].segEnd = leftBottom;
-		vertices2[v2Bottom].segEnd = rightBottom;
-
-		vertices2[v1Bottom].neighbours.push_back(std::make_pair(v2Bottom, Edge2{ bottomSeg, v1Bottom, v2Bottom, diffX, false, true }));
-		vertices2[v2Bottom].neighbours.push_back(std::make_pair(v1Bottom, Edge2{ bottomSeg, v2Bottom, v1Bottom, diffX, false, true }));
+		addEdge(leftBottom, Edge2{ bottomSeg, v1Bottom, v2Bottom, diffX, false, true });
+		addEdge(rightBottom, Edge2{ bottomSeg, v2Bottom, v1Bottom, diffX, false, true });
 	}
+
+	Compress(m_edges2, vertNum, m_offsets2, m_lookup2);
+	m_coverIds2 = AssignCoverIds(m_edges2, vertNum, [](const Edge2& edge) { return edge.isVertical; });
 }
 
 SegmentGraph::SegmentGraph(const std::vector<Segment3>& innerSegments, const std::vector<Segment3>& contourSegments) {
-	vertices3 = std::vector<Vertex3>(contourSegments.size() / 2);
-	
-	// since innerSegments and contourSegments contain segments in both directions, we don't have to create incoming edges now
+	const int vertNum = static_cast<int>(contourSegments.size());
+	vertices3 = std::vector<SegmentEnd3>(vertNum);
 
+	size_t numPoints = 0;
 	for (const auto& seg : innerSegments) {
-		int v1 = seg.p1.id;
-		int v2 = seg.p2.id;
+		numPoints += seg.p1p2.size();
+	}
+	m_points3.reserve(numPoints);
+	m_edges3.reserve(2 * (innerSegments.size() + contourSegments.size()));
 
-		vertices3[v1].segEnd = seg.p1;
-		vertices3[v1].neighbours.push_back(std::make_pair(v2, Edge3{ seg, v1, v2, seg.contourSegment }));
+	// the reversed edge follows its segment, as if both directions had been given one after another
+	for (const auto& seg : innerSegments) {
+		const int begin = static_cast<int>(m_points3.size());
+		m_points3.insert(m_points3.end(), seg.p1p2.begin(), seg.p1p2.end());
+		const int end = static_cast<int>(m_points3.size());
+
+		vertices3[seg.p1.id] = seg.p1;
+		vertices3[seg.p2.id] = seg.p2;
+		m_edges3.push_back(Edge3{ seg.p1, seg.p2, seg.p1.id, seg.p2.id, seg.contourSegment, begin, end, false });
+		m_edges3.push_back(Edge3{ seg.p2, seg.p1, seg.p2.id, seg.p1.id, seg.contourSegment, begin, end, true });
 	}
 
+	std::unordered_set<long long> added;
+	for (const auto& edge : m_edges3) {
+		added.insert(Key(edge.v1, edge.v2, vertNum));
+	}
+	auto addContourEdge = [&](const SegmentEnd3& from, const SegmentEnd3& to, bool contourSegment) {
+		if (added.insert(Key(from.id, to.id, vertNum)).second) {
+			vertices3[from.id] = from;
+			m_edges3.push_back(Edge3{ from, to, from.id, to.id, contourSegment });
+		}
+	};
 	for (const auto& seg : contourSegments) {
-		int v1 = seg.p1.id;
-		int v2 = seg.p2.id;
+		addContourEdge(seg.p1, seg.p2, seg.contourSegment);
+		addContourEdge(seg.p2, seg.p1, seg.contourSegment);
+	}
 
-		auto end = vertices3[v1].neighbours.end();
-		auto it = std::find_if(vertices3[v1].neighbours.begin(), end, [&v2](const std::pair<int, Edge3>& el) {
-			return el.first == v2;
-		});
-		if (it == end) {
-			vertices3[v1].segEnd = seg.p1;
-			vertices3[v1].neighbours.push_back(std::make_pair(v2, Edge3{ seg, v1, v2, seg.contourSegment }));
-		}
+	Compress(m_edges3, vertNum, m_offsets3, m_lookup3);
+	m_coverIds3 = AssignCoverIds(m_edges3, vertNum, [](const Edge3& edge) { return !edge.contourEdge; });
+}
+
+std::span<const SegmentGraph::Edge2> SegmentGraph::Neighbours2(int v) const {
+	return { m_edges2.data() + m_offsets2[v], m_edges2.data() + m_offsets2[v + 1] };
+}
+
+std::span<const SegmentGraph::Edge3> SegmentGraph::Neighbours3(int v) const {
+	return { m_edges3.data() + m_offsets3[v], m_edges3.data() + m_offsets3[v + 1] };
+}
+
+const SegmentGraph::Edge2* SegmentGraph::FindEdge2(int from, int to) const {
+	auto it = m_lookup2.find(Key(from, to, static_cast<int>(vertices2.size())));
+	return it == m_lookup2.end() ? nullptr : &m_edges2[it->second];
+}
+
+const SegmentGraph::Edge3* SegmentGraph::FindEdge3(int from, int to) const {
+	auto it = m_lookup3.find(Key(from, to, static_cast<int>(vertices3.size())));
+	return it == m_lookup3.end() ? nullptr : &m_edges3[it->second];
+}
+
+std::span<const gmod::vector3<float>> SegmentGraph::Points3(const Edge3& edge) const {
+	return { m_points3.data() + edge.pointsBegin, m_points3.data() + edge.pointsEnd };
+}
+
+template<typename Edge>
+void SegmentGraph::Compress(std::vector<Edge>& edges, int numVertices, std::vector<int>& offsets, std::unordered_map<long long, int>& lookup) {
+	offsets.assign(numVertices + 1, 0);
+	for (const auto& edge : edges) {
+		offsets[edge.v1 + 1]++;
+	}
+	for (int v = 0; v < numVertices; v++) {
+		offsets[v + 1] += offsets[v];
+	}
+
+	std::vector<Edge> sorted(edges.size());
+	std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+	for (const auto& edge : edges) {
+		sorted[fill[edge.v1]++] = edge;
+	}
+	edges = std::move(sorted);
+
+	lookup.clear();
+	lookup.reserve(edges.size());
+	for (int e = 0; e < static_cast<int>(edges.size()); e++) {
+		lookup.try_emplace(Key(edges[e].v1, edges[e].v2, numVertices), e);
 	}
 }
 
-std::vector<int> SegmentGraph::SpecialDFS2(int startVertex) const {
-	std::set<std::pair<int, int>> uncoveredVerticalEdges;
-	for (const Vertex2& vertex : vertices2) {
-		for (const auto& neighbour : vertex.neighbours) {
-			if (neighbour.second.isVertical) {
-				uncoveredVerticalEdges.insert(std::make_pair(
-					std::min(neighbour.second.v1, neighbour.second.v2),
-					std::max(neighbour.second.v1, neighbour.second.v2)
-				));
-			}
+long long SegmentGraph::Key(int from, int to, int numVertices) {
+	return static_cast<long long>(from) * numVertices + to;
+}
+
+template<typename Edge, typename Covered>
+int SegmentGraph::AssignCoverIds(std::vector<Edge>& edges, int numVertices, Covered&& covered) {
+	std::unordered_map<long long, int> ids;
+	for (auto& edge : edges) {
+		if (covered(edge)) {
+			const long long key = Key(std::min(edge.v1, edge.v2), std::max(edge.v1, edge.v2), numVertices);
+			edge.coverId = ids.try_emplace(key, static_cast<int>(ids.size())).first->second;
+		}
+	}
+
+	const int count = static_cast<int>(ids.size());
+	for (auto& edge : edges) {
+		if (edge.coverId == -1) {
+			edge.coverId = count;
 		}
 	}
+	return count;
+}
+
+std::vector<int> SegmentGraph::SpecialDFS2(int startVertex) const {
+	// bit per vertical vertex pair, the extra last bit stays clear for the other edges
+	std::vector<bool> uncovered(m_coverIds2 + 1, true);
+	uncovered[m_coverIds2] = false;
+	int numUncovered = m_coverIds2;
+
     std::vector<int> path = { startVertex };
 
     std::stack<int> stack;
@@ -134,28 +200,22 @@ std::vector<int> SegmentGraph::SpecialDFS2(int startVertex) const {
 	std::vector<bool> visited(vertices2.size(), false);
     visited[startVertex] = 1;
 
-    while (!stack.empty() && !uncoveredVerticalEdges.empty()) {
+    while (!stack.empty() && numUncovered > 0) {
         int u = stack.top();
-		auto& neighbours = vertices2[u].neighbours;
+		const auto neighbours = Neighbours2(u);
 
         // find best neighbor (uncovered vertical > shorter edge > any neighbor)
 		int bestNB = -1;
         int bestNeighbourIdx = -1;
         float bestScore = -1.0f;
 		for (int i = 0; i < neighbours.size(); i++) {
-			const auto& [nb, edge] = vertices2[u].neighbours[i];
+			const auto& edge = neighbours[i];
+			const int nb = edge.v2;
 
 			if (visited[nb]) { continue; }
 
-            float score = 0.0f;
-            if (edge.isVertical) {
-                auto edgeKey = std::make_pair(std::min(u, nb), std::max(u, nb));
-                if (uncoveredVerticalEdges.count(edgeKey) == 1) {
-                    score += 1000.0f; // big bonus
-                }
-            }
-            // prefer shorter
-            score += 1.0f / (edge.dist + 0.1f);
+            // big bonus for uncovered vertical, prefer shorter
+            float score = 1000.0f * uncovered[edge.coverId] + 1.0f / (edge.dist + 0.1f);
 
             if (score > bestScore) {
                 bestScore = score;
@@ -165,10 +225,10 @@ std::vector<int> SegmentGraph::SpecialDFS2(int startVertex) const {
         }
 
         if (bestNB != -1) {
-			const auto& edge = neighbours[bestNeighbourIdx].second;
-            if (edge.isVertical) {
-                auto edgeKey = std::make_pair(std::min(u, bestNB), std::max(u, bestNB));
-				uncoveredVerticalEdges.erase(edgeKey);
+			const auto& edge = neighbours[bestNeighbourIdx];
+            if (uncovered[edge.coverId]) {
+				uncovered[edge.coverId] = false;
+				numUncovered--;
             }
 
             visited[bestNB] = true;
@@ -187,17 +247,11 @@ std::vector<int> SegmentGraph::SpecialDFS2(int startVertex) const {
 }
 
 std::vector<int> SegmentGraph::SpecialDFS3(int startVertex) const {
-	std::set<std::pair<int, int>> uncoveredInnerEdges;
-	for (const Vertex3& vertex : vertices3) {
-		for (const auto& neighbour : vertex.neighbours) {
-			if (!neighbour.second.contourEdge) {
-				uncoveredInnerEdges.insert(std::make_pair(
-					std::min(neighbour.second.v1, neighbour.second.v2),
-					std::max(neighbour.second.v1, neighbour.second.v2)
-				));
-			}
-		}
-	}
+	// bit per inner vertex pair, the extra last bit stays clear for contour edges
+	std::vector<bool> uncovered(m_coverIds3 + 1, true);
+	uncovered[m_coverIds3] = false;
+	int numUncovered = m_coverIds3;
+
 	std::vector<int> path = { startVertex };
 
 	std::stack<int> stack;
@@ -206,26 +260,21 @@ std::vector<int> SegmentGraph::SpecialDFS3(int startVertex) const {
 	std::vector<bool> visited(vertices3.size(), false);
 	visited[startVertex] = true;
 
-	while (!stack.empty() && !uncoveredInnerEdges.empty()) {
+	while (!stack.empty() && numUncovered > 0) {
 		int u = stack.top();
-		auto& neighbours = vertices3[u].neighbours;
+		const auto neighbours = Neighbours3(u);
 
 		// find best neighbor (uncovered inner > other)
 		int bestNB = -1;
 		int bestNeighbourIdx = -1;
 		int bestScore = -1;
 		for (int i = 0; i < neighbours.size(); i++) {
-			const auto& [nb, edge] = vertices3[u].neighbours[i];
+			const auto& edge = neighbours[i];
+			const int nb = edge.v2;
 
 			if (visited[nb]) { continue; }
 
-			int score = 0;
-			if (!edge.contourEdge) {
-				auto edgeKey = std::make_pair(std::min(u, nb), std::max(u, nb));
-				if (uncoveredInnerEdges.count(edgeKey) == 1) {
-					score += 100; // big bonus
-				}
-			}
+			int score = 100 * uncovered[edge.coverId]; // big bonus
 
 			if (score > bestScore) {
 				bestScore = score;
@@ -235,10 +284,10 @@ std::vector<int> SegmentGraph::SpecialDFS3(int startVertex) const {
 		}
 
 		if (bestNB != -1) {
-			const auto& edge = neighbours[bestNeighbourIdx].second;
-			if (!edge.contourEdge) {
-				auto edgeKey = std::make_pair(std::min(u, bestNB), std::max(u, bestNB));
-				uncoveredInnerEdges.erase(edgeKey);
+			const auto& edge = neighbours[bestNeighbourIdx];
+			if (uncovered[edge.coverId]) {
+				uncovered[edge.coverId] = false;
+				numUncovered--;
 			}
 
 			visited[bestNB] = true;
@@ -1,5 +1,7 @@
 #pragma once
+#include <span>
 #include <unordered_map>
+#include <vector>
 #include "../gmod/vector3.h"
 
 namespace app {
@@ -36,6 +38,8 @@ namespace app {
 		std::vector<gmod::vector3<float>> p1p2; // only populated if contourSegment == false
 	};
 
+	// edges of all vertices are stored in one array grouped by their start vertex (compressed sparse row)
+	// both directions of an inner stage three edge share one range of the flat point buffer
 	class SegmentGraph {
 	public:
 		struct Edge2 {
@@ -45,36 +49,65 @@ namespace app {
 			float dist;
 			bool isVertical;
 			bool isHorizontal;
-		};
-		struct Vertex2 {
-			SegmentEnd2 segEnd;
-
-			std::vector<std::pair<int, Edge2>> neighbours;
+			// dense id of the vertex pair of a vertical edge, the last id is shared by edges that need no covering
+			int coverId = -1;
 		};
 
 		struct Edge3 {
-			Segment3 seg;
+			SegmentEnd3 p1;
+			SegmentEnd3 p2;
 
 			int v1, v2;
 			bool contourEdge;
+			// range of the points in the buffer, walked from the end when the edge is reversed
+			int pointsBegin = 0;
+			int pointsEnd = 0;
+			bool reversed = false;
+			// dense id of the vertex pair of an inner edge, the last id is shared by edges that need no covering
+			int coverId = -1;
 		};
-		struct Vertex3 {
-			SegmentEnd3 segEnd;
 
-			std::vector<std::pair<int, Edge3>> neighbours;
-		};
-
-		std::vector<Vertex2> vertices2;
-		std::vector<Vertex3> vertices3;
+		std::vector<SegmentEnd2> vertices2;
+		std::vector<SegmentEnd3> vertices3;
 
 		// for stage two
 		SegmentGraph(const std::vector<std::pair<float, std::vector<Segment2>>>& verticalSegments,
 			const std::vector<Segment2>& contourSegments, int vertNum);
 
-		// for stage three
+		// for stage three, segments are given in one direction and the reversed edges are added for them
 		SegmentGraph(const std::vector<Segment3>& innerSegments, const std::vector<Segment3>& contourSegments);
 
+		// outgoing edges in the order they were added
+		std::span<const Edge2> Neighbours2(int v) const;
+		std::span<const Edge3> Neighbours3(int v) const;
+		// first edge added from one vertex to the other, nullptr if there is none
+		const Edge2* FindEdge2(int from, int to) const;
+		const Edge3* FindEdge3(int from, int to) const;
+		// points of an inner edge in the buffer order, see Edge3::reversed
+		std::span<const gmod::vector3<float>> Points3(const Edge3& edge) const;
+
 		std::vector<int> SpecialDFS2(int startVertex) const;
 		std::vector<int> SpecialDFS3(int startVertex) const;
+	private:
+		std::vector<Edge2> m_edges2;
+		std::vector<int> m_offsets2;
+		std::unordered_map<long long, int> m_lookup2;
+
+		std::vector<Edge3> m_edges3;
+		std::vector<int> m_offsets3;
+		std::unordered_map<long long, int> m_lookup3;
+		std::vector<gmod::vector3<float>> m_points3;
+
+		// numbers of vertex pairs the DFS has to cover
+		int m_coverIds2 = 0;
+		int m_coverIds3 = 0;
+
+		// stable counting sort of the edges by start vertex, the lookup keeps the first edge of every pair
+		template<typename Edge>
+		static void Compress(std::vector<Edge>& edges, int numVertices, std::vector<int>& offsets, std::unordered_map<long long, int>& lookup);
+		static long long Key(int from, int to, int numVertices);
+		// both directions of a pair get the same id, returns the number of ids given to covered edges
+		template<typename Edge, typename Covered>
+		static int AssignCoverIds(std::vector<Edge>& edges, int numVertices, Covered&& covered);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "SegmentGrid.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace app;
+
+SegmentGrid::SegmentGrid(const std::vector<Point2>& points, float margin) : m_margin(margin) {
+	const int n = static_cast<int>(points.size());
+	if (n < 2) {
+		m_starts.assign(2, 0);
+		return;
+	}
+
+	float maxX = points.front().x, maxZ = points.front().z;
+	m_minX = maxX;
+	m_minZ = maxZ;
+	double totalLength = 0;
+	for (int k = 0; k < n; k++) {
+		const Point2& a = points[k];
+		const Point2& b = points[(k + 1) % n];
+		m_minX = std::min(m_minX, a.x);
+		m_minZ = std::min(m_minZ, a.z);
+		maxX = std::max(maxX, a.x);
+		maxZ = std::max(maxZ, a.z);
+		totalLength += std::hypot(b.x - a.x, b.z - a.z);
+	}
+	m_minX -= margin;
+	m_minZ -= margin;
+	const float width = maxX + margin - m_minX;
+	const float length = maxZ + margin - m_minZ;
+
+	const float minCellSize = std::sqrt(width * length / (static_cast<float>(m_maxCellsPerSegment) * n));
+	m_cellSize = std::max({ m_lengthsPerCell * static_cast<float>(totalLength / n), minCellSize, margin });
+	m_cellsX = std::max(1, static_cast<int>(std::ceil(width / m_cellSize)));
+	m_cellsZ = std::max(1, static_cast<int>(std::ceil(length / m_cellSize)));
+
+	// counting sort of the segments into cells, first pass counts, second one fills
+	auto forEachCell = [&](int k, auto&& func) {
+		const Point2& a = points[k];
+		const Point2& b = points[(k + 1) % n];
+		const int x0 = CellX(std::min(a.x, b.x) - margin), x1 = CellX(std::max(a.x, b.x) + margin);
+		const int z0 = CellZ(std::min(a.z, b.z) - margin), z1 = CellZ(std::max(a.z, b.z) + margin);
+		for (int x = x0; x <= x1; x++) {
+			for (int z = z0; z <= z1; z++) {
+				func(x * m_cellsZ + z);
+			}
+		}
+	};
+
+	m_starts.assign(m_cellsX * m_cellsZ + 1, 0);
+	for (int k = 0; k < n; k++) {
+		forEachCell(k, [&](int cell) { m_starts[cell + 1]++; });
+	}
+	for (int c = 0; c < m_cellsX * m_cellsZ; c++) {
+		m_starts[c + 1] += m_starts[c];
+	}
+
+	m_items.resize(m_starts.back());
+	std::vector<int> fill(m_starts.begin(), m_starts.end() - 1);
+	for (int k = 0; k < n; k++) {
+		forEachCell(k, [&](int cell) { m_items[fill[cell]++] = k; });
+	}
+}
+
+void SegmentGrid::Candidates(const Point2& a, const Point2& b, std::vector<int>& result) const {
+	result.clear();
+
+	const int x0 = CellX(std::min(a.x, b.x)), x1 = CellX(std::max(a.x, b.x));
+	const int z0 = CellZ(std::min(a.z, b.z)), z1 = CellZ(std::max(a.z, b.z));
+	for (int x = x0; x <= x1; x++) {
+		for (int z = z0; z <= z1; z++) {
+			const int cell = x * m_cellsZ + z;
+			result.insert(result.end(), m_items.begin() + m_starts[cell], m_items.begin() + m_starts[cell + 1]);
+		}
+	}
+
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+}
+
+int SegmentGrid::CellX(float x) const {
+	return std::clamp(static_cast<int>(std::floor((x - m_minX) / m_cellSize)), 0, m_cellsX - 1);
+}
+
+int SegmentGrid::CellZ(float z) const {
+	return std::clamp(static_cast<int>(std::floor((z - m_minZ) / m_cellSize)), 0, m_cellsZ - 1);
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "Geometry2D.h"
+#include <vector>
+
+namespace app {
+	// uniform grid over segments of a closed polyline, segment k joins points k and (k + 1) % n
+	// every segment is binned into the cells covered by its bounding box grown by the margin,
+	// so a query touches only the segments lying near it instead of the whole polyline
+	class SegmentGrid {
+	public:
+		SegmentGrid(const std::vector<Point2>& points, float margin);
+
+		// indices of the segments whose grown boxes overlap the box of a-b, sorted and without repetitions
+		void Candidates(const Point2& a, const Point2& b, std::vector<int>& result) const;
+	private:
+		// side of a cell in average segment lengths, a typical segment covers one or two cells
+		const float m_lengthsPerCell = 2.f;
+		// the grid has at most that many cells per segment, keeps it small for polylines with a few long segments
+		const int m_maxCellsPerSegment = 4;
+
+		float m_margin;
+		float m_minX = 0.f, m_minZ = 0.f;
+		float m_cellSize = 1.f;
+		int m_cellsX = 1, m_cellsZ = 1;
+
+		// segments of cell c are m_items[m_starts[c] .. m_starts[c + 1])
+		std::vector<int> m_starts;
+		std::vector<int> m_items;
+
+		int CellX(float x) const;
+		int CellZ(float z) const;
+	};
+}
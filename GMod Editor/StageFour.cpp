@@ -1,6 +1,9 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include "StageFour.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <bit>
 #include <stack>
 
 using namespace app;
@@ -17,21 +20,26 @@ void StageFour::LoadImageSTB() {
         throw std::runtime_error("Failed to load image: " + m_texturePath);
     }
 
-    m_boolMap = std::vector<std::vector<bool>>(m_resZ, std::vector<bool>(m_resX));
+    m_mask = BitMask(m_resX, m_resZ);
 
+    // rows are written by separate threads, they never share a word
     int t = 200;
     if (channels == 1 || channels == 2) {
-        for (int i = 0; i < m_resX * m_resZ; i++) {
-            m_boolMap[i / m_resX][i % m_resX] = data[i * channels] < t;
-        }
+        Parallel::For(0, m_resZ, [&](int z) {
+            for (int x = 0; x < m_resX; x++) {
+                m_mask.Set(x, z, data[(z * m_resX + x) * channels] < t);
+            }
+        });
     } else if (channels == 3 || channels == 4) {
-        for (int i = 0; i < m_resX * m_resZ; i++) {
-            int idx = i * channels;
-            unsigned char r = data[idx];
-            unsigned char g = data[idx + 1];
-            unsigned char b = data[idx + 2];
-            m_boolMap[i / m_resX][i % m_resX] = (r < t || g < t || b < t);
-        }
+        Parallel::For(0, m_resZ, [&](int z) {
+            for (int x = 0; x < m_resX; x++) {
+                int idx = (z * m_resX + x) * channels;
+                unsigned char r = data[idx];
+                unsigned char g = data[idx + 1];
+                unsigned char b = data[idx + 2];
+                m_mask.Set(x, z, r < t || g < t || b < t);
+            }
+        });
     } else {
         stbi_image_free(data);
         throw std::runtime_error("Unsupported number of channels");
@@ -39,46 +47,31 @@ void StageFour::LoadImageSTB() {
     stbi_image_free(data);
 }
 
-std::vector<StageFour::Pixel> StageFour::PixelPath(std::vector<std::vector<bool>>& visited, int xStart, int zStart) const {
+std::vector<StageFour::Pixel> StageFour::PixelPath(const BitMask& mask, const BitMask::Component& component) const {
     std::vector<Pixel> path;
-    if (xStart < 0 || xStart >= m_resX || zStart < 0 || zStart >= m_resZ) {
-        return path;
-    }
-
-    if (visited[zStart][xStart] || !m_boolMap[zStart][xStart]) {
-        return path; 
-    }
+    BitMask visited(component.maxX - component.minX + 1, component.maxZ - component.minZ + 1);
 
     const int dx[8] = { -1, 0, 1, -1, 1, -1, 0, 1 };
     const int dz[8] = { -1, -1, -1, 0, 0, 1, 1, 1 };
 
     std::stack<Pixel> stack;
-    stack.push({ xStart, zStart });
-    visited[zStart][xStart] = true;
-    path.push_back({ xStart, zStart });
+    stack.push({ component.x, component.z });
+    visited.Set(component.x - component.minX, component.z - component.minZ, true);
+    path.push_back({ component.x, component.z });
 
     while (!stack.empty()) {
         auto [x, z] = stack.top();
 
-        bool foundUnvisitedNeighbor = false;
-        for (int i = 0; i < 8; i++) {
-            int nx = x + dx[i];
-            int nz = z + dz[i];
-
-            if (nx < 0 || nx >= m_resX || nz < 0 || nz >= m_resZ) {
-                continue;
-            }
-
-            if (!visited[nz][nx] && m_boolMap[nz][nx]) {
-                foundUnvisitedNeighbor = true;
-                visited[nz][nx] = true;
-                stack.push({ nx, nz });
-                path.push_back({ nx, nz });
-                break;
-            } 
-        }
-
-        if (!foundUnvisitedNeighbor) {
+        // set neighbours of a component pixel belong to the component, so they lie inside the visited mask
+        const unsigned unvisited = mask.Neighbours(x, z) & ~visited.Neighbours(x - component.minX, z - component.minZ);
+        if (unvisited != 0) {
+            const int i = std::countr_zero(unvisited);
+            const int nx = x + dx[i];
+            const int nz = z + dz[i];
+            visited.Set(nx - component.minX, nz - component.minZ, true);
+            stack.push({ nx, nz });
+            path.push_back({ nx, nz });
+        } else {
             stack.pop();
             if (!stack.empty()) {
                 // moving back
@@ -105,35 +98,102 @@ bool StageFour::AreVeryClose(const gmod::vector3<float>& a, const gmod::vector3<
     return (a - b).length() < 0.2f;
 }
 
+std::vector<gmod::vector3<float>> StageFour::Simplify(const std::vector<gmod::vector3<float>>& points, float tolerance) const {
+    const int n = static_cast<int>(points.size());
+    if (n <= 2) {
+        return points;
+    }
+
+    // ranges are split at their farthest point until it is close enough to the chord
+    std::vector<bool> keep(n, false);
+    keep[0] = keep[n - 1] = true;
+    std::stack<std::pair<int, int>> ranges;
+    ranges.push({ 0, n - 1 });
+    while (!ranges.empty()) {
+        auto [first, last] = ranges.top();
+        ranges.pop();
+
+        const auto& a = points[first];
+        const auto chord = points[last] - a;
+        const float chordLength2 = gmod::dot(chord, chord);
+        float maxDist = 0;
+        int farthest = -1;
+        for (int k = first + 1; k < last; k++) {
+            // distance to the segment, strokes may turn back so the chord line alone is not enough
+            const auto ap = points[k] - a;
+            const float t = chordLength2 > 0 ? std::clamp(gmod::dot(ap, chord) / chordLength2, 0.f, 1.f) : 0.f;
+            const float dist = (ap - chord * t).length();
+            if (dist > maxDist) {
+                maxDist = dist;
+                farthest = k;
+            }
+        }
+
+        if (farthest != -1 && maxDist > tolerance) {
+            keep[farthest] = true;
+            ranges.push({ first, farthest });
+            ranges.push({ farthest, last });
+        }
+    }
+
+    std::vector<gmod::vector3<float>> result;
+    for (int k = 0; k < n; k++) {
+        if (keep[k]) {
+            result.push_back(points[k]);
+        }
+    }
+    return result;
+}
+
 std::vector<gmod::vector3<float>> StageFour::GeneratePath() const {
     std::vector<gmod::vector3<float>> path;
     path.push_back(gmod::vector3<float>(0, totalHeight, 0));
 
+    // every component keeps at least its centreline, dots and short blobs keep all their pixels
+    // a skeleton that lost a component anyway is not used, so no part of the image is left out
+    BitMask mask = m_mask;
+    auto components = mask.Components();
+    if (m_useThinning) {
+        BitMask skeleton = m_mask.Thinned();
+        auto skeletonComponents = skeleton.Components();
+        if (skeletonComponents.size() >= components.size()) {
+            mask = std::move(skeleton);
+            components = std::move(skeletonComponents);
+        }
+    }
+
+    // components come in the order their first pixels are met scanning rows, their strokes are traced independently
+    std::vector<std::vector<Pixel>> pixelPaths(components.size());
+    Parallel::For(0, static_cast<int>(components.size()), [&](int c) {
+        pixelPaths[c] = PixelPath(mask, components[c]);
+    });
+
     bool first = true;
-    std::vector<std::vector<bool>> visited(m_resZ, std::vector<bool>(m_resX, false));
-    for (int z = 0; z < m_resZ; z++) {
-        for (int x = 0; x < m_resX; x++) {
-            if (visited[z][x]) { continue; } // been here already
-            if (!m_boolMap[z][x]) { continue; } // not a part of object
-
-            float height = saveHeight;
-            if (first) {
-                first = false;
-                height = totalHeight;
-            }
+    for (const auto& pixelPath : pixelPaths) {
+        float height = saveHeight;
+        if (first) {
+            first = false;
+            height = totalHeight;
+        }
 
-            std::vector<gmod::vector3<float>> rawPath;
+        std::vector<gmod::vector3<float>> stroke;
+        for (const auto& p : pixelPath) {
+            stroke.push_back(Pixel2Pos(p.x, p.z));
+        }
 
-            auto pixelPath = PixelPath(visited, x, z);
-            auto start = Pixel2Pos(pixelPath.front().x, pixelPath.front().z);
-            rawPath.push_back(gmod::vector3<float>(start.x(), height, start.z()));
-            for (const auto& p : pixelPath) {
-                rawPath.push_back(Pixel2Pos(p.x, p.z));
+        std::vector<gmod::vector3<float>> filtered;
+        if (m_useThinning) {
+            filtered.push_back(gmod::vector3<float>(stroke.front().x(), height, stroke.front().z()));
+            for (const auto& p : Simplify(stroke, m_simplifyTolerance)) {
+                filtered.push_back(p);
             }
-            auto end = Pixel2Pos(pixelPath.back().x, pixelPath.back().z);
-            rawPath.push_back(gmod::vector3<float>(end.x(), saveHeight, end.z()));
+            filtered.push_back(gmod::vector3<float>(stroke.back().x(), saveHeight, stroke.back().z()));
+        } else {
+            std::vector<gmod::vector3<float>> rawPath;
+            rawPath.push_back(gmod::vector3<float>(stroke.front().x(), height, stroke.front().z()));
+            rawPath.insert(rawPath.end(), stroke.begin(), stroke.end());
+            rawPath.push_back(gmod::vector3<float>(stroke.back().x(), saveHeight, stroke.back().z()));
 
-            std::vector<gmod::vector3<float>> filtered;
             filtered.push_back(rawPath.front());
             for (size_t k = 1; k < rawPath.size() - 1; k++) {
                 auto& prev = filtered.back();
@@ -144,9 +204,9 @@ std::vector<gmod::vector3<float>> StageFour::GeneratePath() const {
                     filtered.push_back(curr);
                 }
             }
-            for (const auto& p : filtered) {
-                path.push_back(p);
-            }
+        }
+        for (const auto& p : filtered) {
+            path.push_back(p);
         }
     }
     path.push_back(gmod::vector3<float>(path.back().x(), totalHeight, path.back().z()));
@@ -1,6 +1,7 @@
 #pragma once
 #include "Object.h"
 #include "Intersection.h"
+#include "BitMask.h"
 #include <map>
 
 namespace app {
@@ -24,19 +25,26 @@ namespace app {
 	private:
 		const float m_radius = 0.5f;
 		const std::string m_texturePath = "./textures/stage_four.bmp";
+		// strokes follow the skeleton of the image and are simplified to polylines instead of pixel moves
+		const bool m_useThinning = true;
+		// largest distance of a traced skeleton pixel from the simplified polyline
+		const float m_simplifyTolerance = 0.05f;
 		int m_resX = 1500;
 		int m_resZ = 1500;
-		std::vector<std::vector<bool>> m_boolMap;
+		BitMask m_mask = BitMask(0, 0);
 
 		void LoadImageSTB();
 		struct Pixel {
 			int x = 0;
 			int z = 0;
 		};
-		std::vector<Pixel> PixelPath(std::vector<std::vector<bool>>& visited, int xStart, int zStart) const;
+		// stroke over the whole component, visited pixels are kept only inside its bounding box
+		std::vector<Pixel> PixelPath(const BitMask& mask, const BitMask::Component& component) const;
 		gmod::vector3<float> Pixel2Pos(int x, int z) const;
 
 		bool AreSimilarXZ(const gmod::vector3<float>& a, const gmod::vector3<float>& b, const gmod::vector3<float>& c) const;
 		bool AreVeryClose(const gmod::vector3<float>& a, const gmod::vector3<float>& b) const;
+		// Douglas-Peucker, every dropped point lies within the tolerance of the kept segment spanning it
+		std::vector<gmod::vector3<float>> Simplify(const std::vector<gmod::vector3<float>>& points, float tolerance) const;
 	};
 }
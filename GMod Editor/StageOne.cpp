@@ -3,12 +3,103 @@
 #include "IGeometrical.h"
 #include "Debug.h";
 #include "Helper.h"
+#include "HeightmapBuilder.h"
+#include "HeightmapCache.h"
+#include "ToolOffset.h"
+#include "Parallel.h"
 
 using namespace app;
 
 std::vector<gmod::vector3<float>> StageOne::GeneratePath(const std::vector<std::unique_ptr<Object>>& sceneObjects, Intersection& intersection) const {
-	std::vector<std::vector<float>> heightmap = CreateHeightmapByUVSampling(sceneObjects);
+	// lowest tip heights of the ball cutter that do not gouge the model
+	// both heightmaps are read back from the cache while the scene stays the same
+	HeightmapCache cache;
+	const ToolOffset::Tool tool = { m_radius, m_radius };
+	const uint64_t fingerprint = cache.Fingerprint(sceneObjects);
+	const float minX = static_cast<float>(topLeftCorner.x());
+	const float minZ = static_cast<float>(topLeftCorner.z());
+	const float method = useSectionHeightmap ? 1.f : 0.f;
+	const uint64_t modelKey = cache.Key(fingerprint, { static_cast<float>(m_resX), static_cast<float>(m_resZ), minX, minZ, width, length, baseY, 0.f, 0.f, method });
+	const uint64_t toolKey = cache.Key(fingerprint, { static_cast<float>(m_resX), static_cast<float>(m_resZ), minX, minZ, width, length, baseY, tool.radius, tool.cornerRadius, method });
+
+	Heightmap toolHeights;
+	if (!cache.Load(toolKey, toolHeights)) {
+		Heightmap heightmap;
+		if (!cache.Load(modelKey, heightmap)) {
+			heightmap = useSectionHeightmap ? CreateHeightmapByIntersections(sceneObjects) : CreateHeightmapByRasterization(sceneObjects);
+			cache.Store(modelKey, heightmap);
+		}
+
+		ToolOffset toolOffset;
+		toolHeights = toolOffset.Dilate(heightmap, tool);
+		cache.Store(toolKey, toolHeights);
+	}
+
+	// calcualte milling heights
+	const float heightBottom = baseY + offset;
+	const float heightTop = heightBottom + (totalHeight - baseY) / 2;
+
+	const float separation = diameter - epsilon * m_radius;
+
+	std::vector<std::vector<gmod::vector3<float>>> lines;
+	if (optimizeRasterAngle) {
+		// candidate directions evenly spread over a half turn, compared by the time of the bottom level
+		std::vector<std::vector<std::vector<gmod::vector3<float>>>> candidates(m_numOfRasterAngles);
+		std::vector<float> times(m_numOfRasterAngles);
+		Parallel::For(0, m_numOfRasterAngles, [&](int i) {
+			const float angle = i * std::numbers::pi_v<float> / m_numOfRasterAngles;
+			candidates[i] = CreateRotatedRasterLines(toolHeights, angle, separation);
+			times[i] = EstimateTime(candidates[i], heightBottom);
+		});
+		const int best = static_cast<int>(std::min_element(times.begin(), times.end()) - times.begin());
+		lines = std::move(candidates[best]);
+	} else {
+		lines = CreateRasterLines(toolHeights, separation);
+	}
+
+	// milling levels, the last one always at the bottom
+	std::vector<float> levels;
+	if (useZLevels) {
+		const float depth = totalHeight - heightBottom;
+		const int numOfLevels = maxStepDown > FZERO ? static_cast<int>(std::ceil(depth / maxStepDown)) : 1;
+		for (int i = 1; i < numOfLevels; i++) {
+			levels.push_back(totalHeight - i * depth / numOfLevels);
+		}
+		levels.push_back(heightBottom);
+	} else {
+		levels = { heightTop, heightBottom };
+	}
+
+	// special points
+	gmod::vector3<float> startPoint(centre.x(), totalHeight + 1.0f, centre.z());
+	gmod::vector3<float> overMillingStart(lines.front().front().x(), totalHeight + 1.0f, lines.front().front().z());
+
+	std::vector<gmod::vector3<float>> path;
+
+	// combine
+	path.push_back(startPoint);
+
+	float clearedLevel = std::numeric_limits<float>::max();
+	for (const float level : levels) {
+		const auto levelPath = LevelPath(lines, level, clearedLevel);
+
+		path.push_back(overMillingStart);
+		for (const auto& pos : levelPath) {
+			path.push_back(pos);
+		}
+		const auto& last = levelPath.back();
+		path.push_back(gmod::vector3<float>(last.x(), totalHeight + 1.0f, last.z()));
+
+		if (useZLevels) {
+			clearedLevel = level;
+		}
+	}
+	path.push_back(startPoint);
 
+	return path;
+}
+
+std::vector<std::vector<gmod::vector3<float>>> StageOne::CreateRasterLines(const Heightmap& toolHeights, float separation) const {
 	// calculate boundaries 
 	const float xLeft = topLeftCorner.x();
 	const float xRight = topLeftCorner.x() + width;
@@ -17,12 +108,6 @@ std::vector<gmod::vector3<float>> StageOne::GeneratePath(const std::vector<std::
 	const float zTop = topLeftCorner.z() - m_radius - 1.0f;
 	const float zBottom = topLeftCorner.z() + length + m_radius + 1.0f;
 
-	// calcualte milling heights
-	const float heightBottom = baseY + offset;
-	const float heightTop = heightBottom + (totalHeight - baseY) / 2;
-
-	const float separation = diameter - epsilon * m_radius;
-
 	// calculate x values
 	std::vector<float> xValues;
 	float xCurr = xLeft;
@@ -41,188 +126,239 @@ std::vector<gmod::vector3<float>> StageOne::GeneratePath(const std::vector<std::
 	const float stepX = width / m_resX;
 	const float stepZ = length / m_resZ;
 
-	std::vector<gmod::vector3<float>> topPath;
-	std::vector<gmod::vector3<float>> bottomPath;
+	// raster lines following the tool heights, ends outside of the stock are left at base height
+	std::vector<std::vector<gmod::vector3<float>>> lines;
 	for (const float& xVal : xValues) {
-		topPath.push_back(gmod::vector3<float>(currPos.x(), heightTop, currPos.z()));
-		bottomPath.push_back(gmod::vector3<float>(currPos.x(), heightBottom, currPos.z()));
+		std::vector<gmod::vector3<float>> line;
+		line.push_back(gmod::vector3<float>(currPos.x(), baseY, currPos.z()));
 
 		bool dir = direction == 1;
 
 		auto nextPos = currPos;
 		nextPos.z() = dir ? zBottom : zTop;
 
-		const int x = static_cast<int>((xVal - topLeftCorner.x()) / width * m_resX);
+		const int x = std::clamp(static_cast<int>((xVal - topLeftCorner.x()) / width * m_resX), 0, m_resX);
 		
 		for (int z = dir ? 0 : m_resZ; dir ? z <= m_resZ : z >= 0; z += direction) {
 			const float zVal = z * stepZ + topLeftCorner.z();
-			const float yVal = CheckInRange(heightmap, x, z) + offset;
+			const float yVal = toolHeights.At(x, z) + offset;
 
-			topPath.push_back(gmod::vector3<float>(xVal, std::max(yVal, heightTop), zVal));
-			bottomPath.push_back(gmod::vector3<float>(xVal, std::max(yVal, heightBottom), zVal));
+			line.push_back(gmod::vector3<float>(xVal, yVal, zVal));
 		}
 
-		topPath.push_back(gmod::vector3<float>(nextPos.x(), heightTop, nextPos.z()));
-		bottomPath.push_back(gmod::vector3<float>(nextPos.x(), heightBottom, nextPos.z()));
+		line.push_back(gmod::vector3<float>(nextPos.x(), baseY, nextPos.z()));
+		lines.push_back(std::move(line));
 
 		currPos = nextPos;
 		currPos.x() = currPos.x() + moveToRight;
 		direction *= -1;
 	}
 
-	topPath = MakeSmooth(topPath);
-	bottomPath = MakeSmooth(bottomPath);
-
-	// filter
-	std::vector<gmod::vector3<float>> topPathFiltered;
-	topPathFiltered.push_back(topPath.front());
-	for (int i = 1; i < topPath.size() - 1; i++) {
-		float currY = topPath[i].y();
+	return lines;
+}
 
-		if (Helper::AreEqualF(topPath[i].z(), zTop, FZERO) || Helper::AreEqualF(topPath[i].z(), zBottom, FZERO)) {
-			topPathFiltered.push_back(topPath[i]);
-		}
-		if (Helper::AreEqualF(topPath[i - 1].y(), currY, FZERO) && Helper::AreEqualF(topPath[i + 1].y(), currY, FZERO)) {
-			continue;
-		}
-		topPathFiltered.push_back(topPath[i]);
+std::vector<std::vector<gmod::vector3<float>>> StageOne::CreateRotatedRasterLines(const Heightmap& toolHeights, float angle, float separation) const {
+	// lines run along u and follow each other along w, angle 0 gives lines along z
+	const float ux = std::sin(angle);
+	const float uz = std::cos(angle);
+	const float wx = uz;
+	const float wz = -ux;
+
+	const float halfWidth = width / 2;
+	const float halfLength = length / 2;
+	const float margin = m_radius + 1.0f;
+	const float step = std::min(toolHeights.StepX(), toolHeights.StepZ());
+
+	// calculate w values, from the edge of the stock
+	const float extent = halfWidth * std::abs(wx) + halfLength * std::abs(wz);
+	std::vector<float> wValues;
+	float wCurr = -extent;
+	while (wCurr < extent) {
+		wValues.push_back(wCurr);
+		wCurr += separation;
 	}
-	topPathFiltered.push_back(topPath.back());
-
-	std::vector<gmod::vector3<float>> bottomPathFiltered;
-	bottomPathFiltered.push_back(bottomPath.front());
-	for (int i = 1; i < bottomPath.size() - 1; i++) {
-		float currY = bottomPath[i].y();
-
-		if (Helper::AreEqualF(bottomPath[i].z(), zTop, FZERO) || Helper::AreEqualF(bottomPath[i].z(), zBottom, FZERO)) {
-			bottomPathFiltered.push_back(bottomPath[i]);
+	wValues.push_back(wCurr); // last additional
+
+	// straight move sampled densely, heights of the tool keep it above the model everywhere
+	auto appendMove = [&](std::vector<gmod::vector3<float>>& line, float ax, float az, float bx, float bz, bool withEnds) {
+		const int numOfSteps = std::max(1, static_cast<int>(std::ceil(std::hypot(bx - ax, bz - az) / step)));
+		for (int k = withEnds ? 0 : 1; k <= (withEnds ? numOfSteps : numOfSteps - 1); k++) {
+			const float t = static_cast<float>(k) / numOfSteps;
+			const float x = ax + t * (bx - ax);
+			const float z = az + t * (bz - az);
+			line.push_back(gmod::vector3<float>(x, toolHeights.Sample(x, z) + offset, z));
 		}
-		if (Helper::AreEqualF(bottomPath[i - 1].y(), currY, FZERO) && Helper::AreEqualF(bottomPath[i + 1].y(), currY, FZERO)) {
-			continue;
-		} 
-		bottomPathFiltered.push_back(bottomPath[i]);
-	}
-	bottomPathFiltered.push_back(bottomPath.back());
-
-	// special points
-	gmod::vector3<float> startPoint(centre.x(), totalHeight + 1.0f, centre.z());
-	gmod::vector3<float> overMillingStart(xLeft, totalHeight + 1.0f, zTop);
+	};
+
+	std::vector<std::vector<gmod::vector3<float>>> lines;
+	int direction = 1;
+	for (const float w : wValues) {
+		const float originX = centre.x() + w * wx;
+		const float originZ = centre.z() + w * wz;
+
+		// part of the line over the stock
+		float sMin = std::numeric_limits<float>::lowest();
+		float sMax = std::numeric_limits<float>::max();
+		auto clip = [&](float from, float dir, float half) {
+			if (std::abs(dir) < FZERO) { return; }
+			const float s1 = (-half - from) / dir;
+			const float s2 = (half - from) / dir;
+			sMin = std::max(sMin, std::min(s1, s2));
+			sMax = std::min(sMax, std::max(s1, s2));
+		};
+		clip(originX - centre.x(), ux, halfWidth);
+		clip(originZ - centre.z(), uz, halfLength);
+		if (sMin > sMax) {
+			// line passing beside the stock
+			sMin = sMax = (sMin + sMax) / 2;
+		}
+		sMin -= margin;
+		sMax += margin;
 
-	std::vector<gmod::vector3<float>> path;
-	path.reserve(1 + 1 + topPath.size() + 1 + 1 + bottomPath.size() + 1 + 1);
+		const float sStart = direction == 1 ? sMin : sMax;
+		const float sEnd = direction == 1 ? sMax : sMin;
 
-	// combine
-	path.push_back(startPoint);
+		std::vector<gmod::vector3<float>> line;
+		appendMove(line, originX + sStart * ux, originZ + sStart * uz, originX + sEnd * ux, originZ + sEnd * uz, true);
+		lines.push_back(std::move(line));
 
-	path.push_back(overMillingStart);
-	for (const auto& pos : topPathFiltered) {
-		path.push_back(pos);
+		direction *= -1;
 	}
-	const auto& lastTop = topPathFiltered.back();
-	path.push_back(gmod::vector3<float>(lastTop.x(), totalHeight + 1.0f, lastTop.z()));
 
-	path.push_back(overMillingStart);
-	for (const auto& pos : bottomPathFiltered) {
-		path.push_back(pos);
+	// moves between the lines may cross corners of the stock, they follow the model as well
+	for (int i = 0; i + 1 < lines.size(); i++) {
+		const auto& from = lines[i].back();
+		const auto& to = lines[i + 1].front();
+		appendMove(lines[i], from.x(), from.z(), to.x(), to.z(), false);
 	}
-	const auto& lastBottom = bottomPathFiltered.back();
-	path.push_back(gmod::vector3<float>(lastBottom.x(), totalHeight + 1.0f, lastBottom.z()));
-	path.push_back(startPoint);
 
-	return path;
+	return lines;
 }
 
-float StageOne::CheckInRange(const std::vector<std::vector<float>>& heightmap, int currX, int currZ) const {
-	const int rangeX = m_radius / width * m_resX;
-	const int rangeZ = m_radius / length * m_resZ;
+float StageOne::EstimateTime(const std::vector<std::vector<gmod::vector3<float>>>& lines, float level) const {
+	float pathLength = 0.f;
+	bool first = true;
+	gmod::vector3<float> prev;
+	for (const auto& line : lines) {
+		for (const auto& pos : line) {
+			const gmod::vector3<float> curr(pos.x(), std::max(pos.y(), level), pos.z());
+			if (!first) {
+				pathLength += (curr - prev).length();
+			}
+			prev = curr;
+			first = false;
+		}
+	}
 
-	const int startX = std::max(0, currX - rangeX);
-	const int startZ = std::max(0, currZ - rangeZ);
+	// every line leaves the stock, slows down and turns around
+	return pathLength / m_feedRate + lines.size() * m_lineEndTime;
+}
 
-	const int endX = std::min(m_resX, currX + rangeX);
-	const int endZ = std::min(m_resZ, currZ + rangeZ);
+std::vector<gmod::vector3<float>> StageOne::LevelPath(const std::vector<std::vector<gmod::vector3<float>>>& lines, float level, float clearedLevel) const {
+	std::vector<gmod::vector3<float>> levelPath;
+	for (const auto& line : lines) {
+		int i = 0;
+		while (i < line.size()) {
+			if (line[i].y() < clearedLevel) {
+				levelPath.push_back(gmod::vector3<float>(line[i].x(), std::max(line[i].y(), level), line[i].z()));
+				i++;
+				continue;
+			}
 
-	float y = baseY;
-	for (int x = startX; x <= endX; x++) {
-		for (int z = startZ; z <= endZ; z++) {
-			if (heightmap[x][z] > y) {
-				y = heightmap[x][z];
+			// tool already followed the model there on the previous level, retract and pass over in a straight line
+			// ends of the run stay at their own heights and the moves at them are vertical,
+			// so smoothing does not raise the neighbouring points from the top of the run
+			int j = i;
+			float bridgeY = line[i].y();
+			while (j + 1 < line.size() && line[j + 1].y() >= clearedLevel) {
+				j++;
+				bridgeY = std::max(bridgeY, line[j].y());
 			}
+			levelPath.push_back(line[i]);
+			if (j > i) {
+				levelPath.push_back(gmod::vector3<float>(line[i].x(), bridgeY, line[i].z()));
+				levelPath.push_back(gmod::vector3<float>(line[j].x(), bridgeY, line[j].z()));
+				levelPath.push_back(line[j]);
+			}
+			i = j + 1;
 		}
 	}
 
-	return y;
-}
+	levelPath = MakeSmooth(levelPath);
 
-std::vector<std::vector<float>> StageOne::CreateHeightmapByIntersections(const std::vector<std::unique_ptr<Object>>& sceneObjects, Intersection& intersection) const {
-	intersection.SetIntersectionParameters(m_interParams);
+	// filter
+	std::vector<gmod::vector3<float>> filtered;
+	filtered.push_back(levelPath.front());
+	for (int i = 1; i < levelPath.size() - 1; i++) {
+		const auto& prev = levelPath[i - 1];
+		const auto& curr = levelPath[i];
+		const auto& next = levelPath[i + 1];
+
+		// points where the path turns are kept, like the ends of raster lines
+		const float turn = (curr.x() - prev.x()) * (next.z() - curr.z()) - (curr.z() - prev.z()) * (next.x() - curr.x());
+		if (std::abs(turn) < FZERO && Helper::AreEqualF(prev.y(), curr.y(), FZERO) && Helper::AreEqualF(next.y(), curr.y(), FZERO)) {
+			continue;
+		}
+		filtered.push_back(levelPath[i]);
+	}
+	filtered.push_back(levelPath.back());
 
+	return filtered;
+}
+
+Heightmap StageOne::CreateHeightmapByIntersections(const std::vector<std::unique_ptr<Object>>& sceneObjects) const {
 	// get all surfaces on scene
-	std::vector<Intersection::IDIG> sceneSurfaces;
+	std::vector<const IGeometrical*> sceneSurfaces;
 
 	for (const auto& so : sceneObjects) {
-		IGeometrical* g = dynamic_cast<IGeometrical*>(so.get());
+		const IGeometrical* g = dynamic_cast<const IGeometrical*>(so.get());
 		if (g != nullptr) {
-			sceneSurfaces.push_back({ so->id, g });
+			sceneSurfaces.push_back(g);
 		}
 	}
 
-	// sort based on y value
-	std::sort(sceneSurfaces.begin(), sceneSurfaces.end(), [](const Intersection::IDIG& a, const Intersection::IDIG& b) {
-		return a.s->WorldBounds().max.y() > b.s->WorldBounds().max.y();
-	});
-
-	// create "ray"
-	const float rayWidth = 0.1f;
-	const float rayLenght = totalHeight - baseY;
-	const float rayY = rayLenght / 2 + baseY;
-	const float stepX = width / m_resX;
-	const float stepZ = length / m_resZ;
-
-	// 90 degree rotation in Z results in YZ plane
-	Surface::Plane ray = Surface::MakePlane(centre, rayLenght, rayWidth, { 0,0,90 }, -69);
-
 	// complete heigtmap
-	std::vector<std::vector<float>> heightmap(m_resX + 1, std::vector<float>(m_resZ + 1, baseY));
-	for (int x = 0; x <= m_resX; x++) {
-		const float rayX = x * stepX + topLeftCorner.x();
-		for (int z = 0; z <= m_resZ; z++) {
-			const float rayZ = z * stepZ + topLeftCorner.z();
-
-			ray.surface->SetTranslation(rayX, rayY, rayZ);
-
-			Intersection::IDIG rayIDIG = { ray.surface->id, dynamic_cast<IGeometrical*>(ray.surface.get()) };
-			for (auto& surf : sceneSurfaces) {
-				if (!IGeometrical::XYZBoundsIntersect(surf.s->WorldBounds(), rayIDIG.s->WorldBounds())) { continue; }
-				unsigned int res = intersection.FindIntersection(std::make_pair(surf, rayIDIG));
-				if (res != 0) { continue; }
-
-				float dist = std::max(width, length);
-				float y = baseY;
-
-				for (const auto& poi : intersection.GetPointsOfIntersection()) {
-					float diffX = rayX - poi.pos.x();
-					float diffZ = rayZ - poi.pos.z();
-					float currDist = std::sqrt(diffX * diffX + diffZ * diffZ);
-
-					if (currDist < dist) {
-						dist = currDist;
-						y = poi.pos.y();
+	Heightmap heightmap(m_resX, m_resZ, topLeftCorner.x(), topLeftCorner.z(), width, length, baseY);
+
+	// every column of samples lies on a plane of constant x, its sections give heights along the whole column
+	Parallel::For(0, m_resX + 1, [&](int x) {
+		const float rayX = heightmap.X(x);
+		const PlaneSection::Plane plane = { { 1, 0, 0 }, rayX };
+
+		for (const auto* surf : sceneSurfaces) {
+			const auto bounds = surf->WorldBounds();
+			if (rayX < bounds.min.x() || rayX > bounds.max.x()) { continue; }
+
+			for (const auto& curve : m_planeSection.Section(surf, plane)) {
+				const auto& points = curve.points;
+				const size_t segments = curve.closed ? points.size() : points.size() - 1;
+
+				for (size_t k = 0; k < segments; k++) {
+					const auto& a = points[k].pos;
+					const auto& b = points[(k + 1) % points.size()].pos;
+
+					// samples of the column lying between the ends of the segment
+					const double zMin = std::min(a.z(), b.z());
+					const double zMax = std::max(a.z(), b.z());
+					const int z0 = std::max(0, static_cast<int>(std::ceil((zMin - heightmap.MinZ()) / heightmap.StepZ())));
+					const int z1 = std::min(m_resZ, static_cast<int>(std::floor((zMax - heightmap.MinZ()) / heightmap.StepZ())));
+
+					for (int z = z0; z <= z1; z++) {
+						const double t = zMax > zMin ? (heightmap.Z(z) - a.z()) / (b.z() - a.z()) : 0.0;
+						const float y = static_cast<float>(a.y() + t * (b.y() - a.y()));
+						if (y > heightmap.At(x, z)) {
+							heightmap.At(x, z) = y;
+						}
 					}
 				}
-
-				if (y > heightmap[x][z]) {
-					heightmap[x][z] = y;
-				}
-
 			}
 		}
-	}
+	});
 	return heightmap;
 }
 
-std::vector<std::vector<float>> StageOne::CreateHeightmapByUVSampling(const std::vector<std::unique_ptr<Object>>& sceneObjects) const {
-	std::vector<std::vector<float>> heightmap(m_resX + 1, std::vector<float>(m_resZ + 1, baseY));
+Heightmap StageOne::CreateHeightmapByUVSampling(const std::vector<std::unique_ptr<Object>>& sceneObjects) const {
+	Heightmap heightmap(m_resX, m_resZ, topLeftCorner.x(), topLeftCorner.z(), width, length, baseY);
 
 	// get all surfaces on scene
 	std::vector<IGeometrical*> sceneSurfaces;
@@ -266,8 +402,8 @@ std::vector<std::vector<float>> StageOne::CreateHeightmapByUVSampling(const std:
 				
 				const int x = std::clamp(static_cast<int>((p.x() - topLeftCorner.x()) / stepX), 0, m_resX);
 				const int z = std::clamp(static_cast<int>((p.z() - topLeftCorner.z()) / stepZ), 0, m_resZ);
-				if (p.y() > heightmap[x][z]) {
-					heightmap[x][z] = p.y();
+				if (p.y() > heightmap.At(x, z)) {
+					heightmap.At(x, z) = p.y();
 				}
 
 				v += vStep;
@@ -279,63 +415,50 @@ std::vector<std::vector<float>> StageOne::CreateHeightmapByUVSampling(const std:
 	return heightmap;
 }
 
-std::vector<gmod::vector3<float>> StageOne::MakeSmooth(const std::vector<gmod::vector3<float>>& path) const {
-	if (path.size() < 3) { return path; }
-
-	std::vector<gmod::vector3<float>> smoothed = path;
-	std::vector<bool> smooth(smoothed.size(), false);
-	const float maxSlope = std::tan(maxSlopeInDeg * std::numbers::pi / 180.f);
-	const int maxIterations = 100;
-
-	bool changed = false;
-	int iter = 0;
-
-	do {
-		changed = false;
-		for (int i = 1; i < smoothed.size() - 1; i++) {
-			if (smooth[i]) { 
-				continue;
-			}
-			const auto& prev = smoothed[i - 1];
-			const auto& curr = smoothed[i];
-			const auto& next = smoothed[i + 1];
-
-			const float diffXprev = curr.x() - prev.x();
-			const float diffZprev = curr.z() - prev.z();
-			const float diffXnext = curr.x() - next.x();
-			const float diffZnext = curr.z() - next.z();
+Heightmap StageOne::CreateHeightmapByRasterization(const std::vector<std::unique_ptr<Object>>& sceneObjects) const {
+	Heightmap heightmap(m_resX, m_resZ, topLeftCorner.x(), topLeftCorner.z(), width, length, baseY);
 
-			float distToPrev = std::sqrt(diffXprev * diffXprev + diffZprev * diffZprev);
-			float distToNext = std::sqrt(diffXnext * diffXnext + diffZnext * diffZnext);
+	// get all surfaces on scene
+	std::vector<const IGeometrical*> sceneSurfaces;
 
-			// skip vertical movements or duplicate points
-			if (distToPrev < FZERO || distToNext < FZERO) {
-				continue;
-			}
+	for (const auto& so : sceneObjects) {
+		const IGeometrical* g = dynamic_cast<const IGeometrical*>(so.get());
+		if (g != nullptr) {
+			sceneSurfaces.push_back(g);
+		}
+	}
 
-			// calculate slopes
-			float slopeToPrev = std::abs(curr.y() - prev.y()) / distToPrev;
-			float slopeToNext = std::abs(curr.y() - next.y()) / distToNext;
+	HeightmapBuilder builder;
+	builder.Rasterize(sceneSurfaces, heightmap);
 
-			if (slopeToPrev > maxSlope || slopeToNext > maxSlope) {
-				float targetY = (prev.y() + next.y()) / 2.0f;
-				float minAllowedY = curr.y(); 
+	return heightmap;
+}
 
-				// apply smoothing with constraint
-				float newY = std::max(targetY, minAllowedY);
+std::vector<gmod::vector3<float>> StageOne::MakeSmooth(const std::vector<gmod::vector3<float>>& path) const {
+	if (path.size() < 3) { return path; }
 
-				// only update if actually changing and it's an improvement
+	// lowest path above the original one whose slope never exceeds the limit,
+	// every point is raised to max over j of y[j] - maxSlope * (distance along the path to j)
+	std::vector<gmod::vector3<float>> smoothed = path;
+	const float maxSlope = std::tan(maxSlopeInDeg * std::numbers::pi / 180.f);
 
-				if (!Helper::AreEqualF(newY, smoothed[i].y(), FZERO)) {
-					smoothed[i].y() = newY;
-					changed = true;
-				} else {
-					smooth[i] = true;
-				}
-			}
-		}
-		iter++;
-	} while (changed && iter < maxIterations);
+	auto distXZ = [](const gmod::vector3<float>& a, const gmod::vector3<float>& b) {
+		const float diffX = a.x() - b.x();
+		const float diffZ = a.z() - b.z();
+		return std::sqrt(diffX * diffX + diffZ * diffZ);
+	};
+
+	// vertical movements and duplicate points do not limit the slope
+	for (int i = 1; i < smoothed.size(); i++) {
+		const float dist = distXZ(smoothed[i - 1], smoothed[i]);
+		if (dist < FZERO) { continue; }
+		smoothed[i].y() = std::max(smoothed[i].y(), smoothed[i - 1].y() - maxSlope * dist);
+	}
+	for (int i = static_cast<int>(smoothed.size()) - 2; i >= 0; i--) {
+		const float dist = distXZ(smoothed[i + 1], smoothed[i]);
+		if (dist < FZERO) { continue; }
+		smoothed[i].y() = std::max(smoothed[i].y(), smoothed[i + 1].y() - maxSlope * dist);
+	}
 
 	return smoothed;
 }
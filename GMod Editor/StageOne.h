@@ -1,6 +1,8 @@
 #pragma once
 #include "Object.h"
 #include "Intersection.h"
+#include "Heightmap.h"
+#include "PlaneSection.h"
 #include <map>
 
 namespace app {
@@ -11,7 +13,7 @@ namespace app {
 		const int diameter = 16;
 
 		const float epsilon = 0.2f; // usage: d - eps * r
-		const float maxSlopeInDeg = 20.f; // TODO: actual is around double that - investigate
+		const float maxSlopeInDeg = 20.f;
 		const float offset = 2.f;
 		const float totalHeight = 50.f;
 
@@ -21,28 +23,37 @@ namespace app {
 		const gmod::vector3<double> topLeftCorner = { -75, baseY, -75 };
 		const gmod::vector3<double> centre = { 0, baseY, 0 };
 
+		// multi-level roughing, levels are spread evenly from the stock top down to the bottom pass
+		// parts of the model already followed on a higher level are passed over in straight lines
+		bool useZLevels = false;
+		float maxStepDown = 10.f;
+
+		// model heights from plane sections along the heightmap columns instead of rasterized triangles
+		bool useSectionHeightmap = false;
+
+		// raster direction chosen among evenly spread angles by the estimated milling time
+		bool optimizeRasterAngle = false;
+
 		std::vector<gmod::vector3<float>> GeneratePath(const std::vector<std::unique_ptr<Object>>& sceneObjects, Intersection& intersection) const;
 	private:
 		const float FZERO = 100.f * std::numeric_limits<float>::epsilon();
 		const int m_resX = 1500;
 		const int m_resZ = 1500;
 		const float m_radius = 8.f;
-		const Intersection::InterParams m_interParams = {
-			.gs = 5 * 1e-3,
-			.gt = 5 * 1e-5,
-			.gmi = 10000,
-			.ns = 0.01,
-			.nt = 9 * 1e-3,
-			.nmi = 20,
-			.nmr = 5,
-			.mip = 10000,
-			.d = 0.1,
-			.cpt = 0.09
-		};
-
-		std::vector<std::vector<float>> CreateHeightmapByIntersections(const std::vector<std::unique_ptr<Object>>& sceneObjects, Intersection& intersection) const;
-		std::vector<std::vector<float>> CreateHeightmapByUVSampling(const std::vector<std::unique_ptr<Object>>& sceneObjects) const;
+		const PlaneSection m_planeSection;
+
+		Heightmap CreateHeightmapByIntersections(const std::vector<std::unique_ptr<Object>>& sceneObjects) const;
+		Heightmap CreateHeightmapByUVSampling(const std::vector<std::unique_ptr<Object>>& sceneObjects) const;
+		Heightmap CreateHeightmapByRasterization(const std::vector<std::unique_ptr<Object>>& sceneObjects) const;
+		// used only to compare raster directions
+		const int m_numOfRasterAngles = 12;
+		const float m_feedRate = 20.f; // mm/s
+		const float m_lineEndTime = 1.f; // s
+
+		std::vector<std::vector<gmod::vector3<float>>> CreateRasterLines(const Heightmap& toolHeights, float separation) const;
+		std::vector<std::vector<gmod::vector3<float>>> CreateRotatedRasterLines(const Heightmap& toolHeights, float angle, float separation) const;
+		float EstimateTime(const std::vector<std::vector<gmod::vector3<float>>>& lines, float level) const;
+		std::vector<gmod::vector3<float>> LevelPath(const std::vector<std::vector<gmod::vector3<float>>>& lines, float level, float clearedLevel) const;
 		std::vector<gmod::vector3<float>> MakeSmooth(const std::vector<gmod::vector3<float>>& path) const;
-		float CheckInRange(const std::vector<std::vector<float>>& heightmap, int currX, int currZ) const;
 	};
 }
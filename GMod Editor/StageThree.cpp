@@ -3,19 +3,40 @@
 #include "IGeometrical.h"
 #include "Helper.h"
 #include "OffsetSurface.h"
+#include "Parallel.h"
 #include <utility.h>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
 
 using namespace app;
 
 std::vector<gmod::vector3<float>> StageThree::GeneratePath(const std::vector<std::unique_ptr<Object>>& sceneObjects, Intersection& intersection) const {
-	gmod::vector3<double> baseCentre(centre.x(), centre.y() + m_radius, centre.z());
-	BSurface::Plane base = BSurface::MakePlane(baseCentre, width, length, { 0,0,0 }, -69);
+	BSurface::Plane base = MakeBase();
 	Intersection::IDIG baseIDIG = { base.surface->id, dynamic_cast<IGeometrical*>(base.surface.get()) };
 
+	// solvers and knives are created here, objects should not be constructed on worker threads
+	// the first part uses the given solver, the others get their own
+	const int numOfParts = m_millingParams.size();
+	std::vector<Intersection> solvers(std::max(numOfParts - 1, 0));
+	std::vector<BSurface::Plane> knives;
+	if (m_useKnife) {
+		knives.reserve(numOfParts);
+		for (const auto& params : m_millingParams) {
+			knives.push_back(MakeKnife(params.YRotation));
+		}
+	}
+
+	// parts share only the scene and the base, their paths are joined in the configured order
+	std::vector<std::vector<gmod::vector3<float>>> partPaths(numOfParts);
+	Parallel::For(0, numOfParts, [&](int k) {
+		Intersection& solver = k == 0 ? intersection : solvers[k - 1];
+		partPaths[k] = GeneratePathForPart(sceneObjects, solver, m_millingParams[k], baseIDIG, m_useKnife ? &knives[k] : nullptr);
+	});
+
 	std::vector<gmod::vector3<float>> path;
 	path.push_back(gmod::vector3<float>(0, totalHeight, 0));
-	for (const auto& params : m_millingParams) {
-		auto elementsPath = GeneratePathForPart(sceneObjects, intersection, params, baseIDIG);
+	for (const auto& elementsPath : partPaths) {
 		std::copy(elementsPath.begin(), elementsPath.end(), std::back_inserter(path));
 	}
 	// add manual correction between legs
@@ -28,9 +49,172 @@ std::vector<gmod::vector3<float>> StageThree::GeneratePath(const std::vector<std
 	return path;
 }
 
+std::vector<StageThree::SweepResult> StageThree::Sweep(const std::vector<std::unique_ptr<Object>>& sceneObjects, const std::vector<SweepRange>& ranges) const {
+	struct Job {
+		MillingPartParams params;
+		SweepResult result;
+		size_t range;
+	};
+	std::vector<Job> jobs;
+
+	for (size_t r = 0; r < ranges.size(); r++) {
+		const auto& range = ranges[r];
+		auto it = std::find_if(m_millingParams.begin(), m_millingParams.end(), [&range](const MillingPartParams& params) {
+			return params.name == range.name;
+		});
+		if (it == m_millingParams.end()) {
+			throw std::runtime_error("Wrong name - part " + range.name + " not found.");
+		}
+		if (!range.maxIntersectionPoints.empty() && !m_useKnife) {
+			throw std::runtime_error("Part " + range.name + " : mip is used only by the knife, the active cutting mode ignores it.");
+		}
+		if (!range.epsilons.empty() && m_usePlaneSection && m_useScallopStep && !m_useIsoLines) {
+			throw std::runtime_error("Part " + range.name + " : cuts are spaced by the scallop height, epsilon sets only the first one.");
+		}
+		if ((!range.YRotations.empty() || !range.cuttingDirs.empty()) && m_useIsoLines) {
+			throw std::runtime_error("Part " + range.name + " : iso lines follow the parametrisation, rotation and dir do not change them.");
+		}
+
+		auto values = [](const auto& tried, auto configured) {
+			return tried.empty() ? std::vector<decltype(configured)>{ configured } : tried;
+		};
+		const auto epsilons = values(range.epsilons, it->epsilon);
+		const auto rotations = values(range.YRotations, it->YRotation);
+		const auto dirs = values(range.cuttingDirs, it->cuttingDir);
+		const auto mips = values(range.maxIntersectionPoints, it->cuttingParams.mip);
+
+		// seeds are tried only for surfaces already using the cursor
+		std::vector<std::pair<size_t, std::vector<gmod::vector3<double>>>> seeds;
+		for (size_t s = 0; s < it->intersectingSurfaces.size(); s++) {
+			const auto& surf = it->intersectingSurfaces[s];
+			if (!surf.useCursor) { continue; }
+
+			auto tried = std::find_if(range.cursorSeeds.begin(), range.cursorSeeds.end(), [&surf](const auto& el) {
+				return el.first == surf.name;
+			});
+			seeds.push_back({ s, tried == range.cursorSeeds.end() || tried->second.empty()
+				? std::vector<gmod::vector3<double>>{ surf.cursorPos } : tried->second });
+		}
+
+		// combinations are numbered in a mixed radix, one digit per swept value
+		std::vector<size_t> sizes = { epsilons.size(), rotations.size(), dirs.size(), mips.size() };
+		for (const auto& [s, positions] : seeds) {
+			sizes.push_back(positions.size());
+		}
+		size_t combinations = 1;
+		for (size_t size : sizes) {
+			combinations *= size;
+		}
+
+		for (size_t c = 0; c < combinations; c++) {
+			std::vector<size_t> digits(sizes.size());
+			size_t rest = c;
+			for (size_t d = 0; d < sizes.size(); d++) {
+				digits[d] = rest % sizes[d];
+				rest /= sizes[d];
+			}
+
+			Job job = { *it, {}, r };
+			job.params.epsilon = epsilons[digits[0]];
+			job.params.YRotation = rotations[digits[1]];
+			job.params.cuttingDir = dirs[digits[2]];
+			job.params.cuttingParams.mip = mips[digits[3]];
+			for (size_t d = 0; d < seeds.size(); d++) {
+				auto& surf = job.params.intersectingSurfaces[seeds[d].first];
+				surf.cursorPos = seeds[d].second[digits[4 + d]];
+				job.result.cursorSeeds.push_back({ surf.name, surf.cursorPos });
+			}
+
+			job.result.name = range.name;
+			job.result.epsilon = job.params.epsilon;
+			job.result.YRotation = job.params.YRotation;
+			job.result.cuttingDir = job.params.cuttingDir;
+			job.result.maxIntersectionPoints = job.params.cuttingParams.mip;
+			jobs.push_back(std::move(job));
+		}
+	}
+
+	// solvers and knives are created here, objects should not be constructed on worker threads
+	BSurface::Plane base = MakeBase();
+	Intersection::IDIG baseIDIG = { base.surface->id, dynamic_cast<IGeometrical*>(base.surface.get()) };
+	std::vector<Intersection> solvers(jobs.size());
+	std::vector<BSurface::Plane> knives;
+	if (m_useKnife) {
+		knives.reserve(jobs.size());
+		for (const auto& job : jobs) {
+			knives.push_back(MakeKnife(job.params.YRotation));
+		}
+	}
+
+	// a failed combination is a result as well, it does not stop the others
+	Parallel::For(0, static_cast<int>(jobs.size()), [&](int k) {
+		auto& result = jobs[k].result;
+		const auto start = std::chrono::steady_clock::now();
+		try {
+			const auto path = GeneratePathForPart(sceneObjects, solvers[k], jobs[k].params, baseIDIG, m_useKnife ? &knives[k] : nullptr);
+			for (size_t i = 1; i < path.size(); i++) {
+				result.pathLength += (path[i] - path[i - 1]).length();
+			}
+			result.success = true;
+		} catch (const std::exception& e) {
+			result.error = e.what();
+		}
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	});
+
+	// successful combinations first, then the shorter paths
+	// length is only the cost of a path, a larger epsilon gives a shorter but coarser one, so the first entry is not the best
+	std::stable_sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) {
+		if (a.range != b.range) { return a.range < b.range; }
+		if (a.result.success != b.result.success) { return a.result.success; }
+		return a.result.pathLength < b.result.pathLength;
+	});
+
+	std::vector<SweepResult> results;
+	results.reserve(jobs.size());
+	for (auto& job : jobs) {
+		results.push_back(std::move(job.result));
+	}
+	return results;
+}
+
+std::string StageThree::SweepReport(const std::vector<SweepResult>& results) const {
+	std::ostringstream report;
+	report << std::fixed;
+	report << "successful combinations ordered by path length, shorter is cheaper but not finer\n";
+
+	std::string part = "";
+	int rank = 0;
+	for (const auto& result : results) {
+		if (result.name != part) {
+			part = result.name;
+			rank = 0;
+			report << "== " << part << " ==\n";
+		}
+		rank++;
+
+		report << "#" << rank << std::setprecision(2)
+			<< " epsilon " << result.epsilon
+			<< " rotation " << result.YRotation
+			<< " dir " << result.cuttingDir
+			<< " mip " << result.maxIntersectionPoints;
+		for (const auto& [name, pos] : result.cursorSeeds) {
+			report << " cursor " << name << " (" << pos.x() << ", " << pos.y() << ", " << pos.z() << ")";
+		}
+		report << " | time " << std::setprecision(3) << result.seconds << " s";
+		if (result.success) {
+			report << " | length " << std::setprecision(1) << result.pathLength;
+		} else {
+			report << " | failed: " << result.error;
+		}
+		report << "\n";
+	}
+	return report.str();
+}
+
 std::vector<gmod::vector3<float>> StageThree::GeneratePathForPart(
 	const std::vector<std::unique_ptr<Object>>& sceneObjects, Intersection& intersection,
-	const MillingPartParams& params, const Intersection::IDIG& base) const {
+	const MillingPartParams& params, const Intersection::IDIG& base, BSurface::Plane* knife) const {
 
 	std::vector<std::pair<Intersection::IDIG, NamedInterParams>> surfaces;
 	std::vector<std::unique_ptr<OffsetSurface>> offsetSurfaceStorage; // the offset surfaces must exist until we exit the function
@@ -118,8 +302,16 @@ std::vector<gmod::vector3<float>> StageThree::GeneratePathForPart(
 	contour = filtered;
 	// =====
 
+	// positions of the contour on XZ, its ranges are walked when the path follows it
+	std::vector<Point2> contourPoints;
+	contourPoints.reserve(contour.size());
+	for (const auto& p : contour) {
+		contourPoints.push_back({ p.pos.x(), p.pos.z() });
+	}
+	const Contour contourXZ(std::move(contourPoints), FZERO);
+
 	SegmentEnd3 startingPoint;
-	SegmentGraph G = CutSurfaceIntoGraph(intersection, contour, params.cuttingParams, part, params.epsilon, params.YRotation, params.cuttingDir, startingPoint);
+	SegmentGraph G = CutSurfaceIntoGraph(intersection, knife, contour, contourXZ, params.cuttingParams, part, params.epsilon, params.YRotation, params.cuttingDir, startingPoint);
 	std::vector<int> path = G.SpecialDFS3(startingPoint.id);
 
 	// =====
@@ -144,7 +336,7 @@ std::vector<gmod::vector3<float>> StageThree::GeneratePathForPart(
 	const float lowerValPath = m_radius * 0.99f;
 	std::vector<gmod::vector3<float>> fullPath;
 
-	long firstIdx = G.vertices3[path.front()].segEnd.contourIdx;
+	long firstIdx = G.vertices3[path.front()].contourIdx;
 	gmod::vector3<float> first = contour[firstIdx].pos;
 	fullPath.push_back(gmod::vector3<float>(first.x() + addX, totalHeight, first.z() + addZ));
 	fullPath.push_back(gmod::vector3<float>(first.x() + addX, first.y() - lowerValPath, first.z() + addZ));
@@ -152,56 +344,43 @@ std::vector<gmod::vector3<float>> StageThree::GeneratePathForPart(
 		int fromId = path[v];
 		int toId = path[v + 1];
 
-		const SegmentGraph::Vertex3& fromVertex = G.vertices3[fromId];
-		const SegmentGraph::Vertex3& toVertex = G.vertices3[toId];
-
-		auto it = std::find_if(fromVertex.neighbours.begin(), fromVertex.neighbours.end(), [&toId](const std::pair<int, SegmentGraph::Edge3>& e) {
-			return e.first == toId;
-		});
-
-		if (it == fromVertex.neighbours.end()) {
+		const SegmentEnd3& fromVertex = G.vertices3[fromId];
+		const SegmentGraph::Edge3* edgePtr = G.FindEdge3(fromId, toId);
+		if (edgePtr == nullptr) {
 			throw std::runtime_error("There is an error in created path - edge not found.");
 		}
 
-		auto currPos = contour[fromVertex.segEnd.contourIdx].pos;
+		auto currPos = contour[fromVertex.contourIdx].pos;
 		fullPath.push_back(gmod::vector3<float>(currPos.x(), currPos.y() - lowerValPath, currPos.z()));
 
-		const SegmentGraph::Edge3& edge = it->second;
+		const SegmentGraph::Edge3& edge = *edgePtr;
 		if (edge.contourEdge) { // if we have contour edge, we need to add the points from contour
-			int start = edge.seg.p1.contourIdx;
-			int end = edge.seg.p2.contourIdx;
-
-			if (start < end) {
-				for (int j = start; j <= end; j++) {
-					fullPath.push_back(
-						gmod::vector3<float>(contour[j].pos.x(), contour[j].pos.y() - lowerValPath, contour[j].pos.z())
-					);
-				}
-			} else {
-				for (int j = start; j >= end; j--) {
-					fullPath.push_back(
-						gmod::vector3<float>(contour[j].pos.x(), contour[j].pos.y() - lowerValPath, contour[j].pos.z())
-					);
-				}
+			const size_t start = edge.p1.contourIdx;
+			const size_t end = edge.p2.contourIdx;
+
+			const auto range = start < end ? contourXZ.Forward(start, end) : contourXZ.Backward(start, end);
+			for (size_t j : range) {
+				fullPath.push_back(
+					gmod::vector3<float>(contour[j].pos.x(), contour[j].pos.y() - lowerValPath, contour[j].pos.z())
+				);
 			}
 		} else { // if we have inner edge we take points from segment
-			for (const auto& el : edge.seg.p1p2) {
+			const auto points = G.Points3(edge);
+			for (size_t k = 0; k < points.size(); k++) {
+				const auto& el = points[edge.reversed ? points.size() - 1 - k : k];
 				fullPath.push_back(gmod::vector3<float>(el.x(), el.y() - lowerValPath, el.z()));
 			}
 		}
 	}
 
 	const float lowerValContour = m_radius;
-	long lastIdx = G.vertices3[path.back()].segEnd.contourIdx;
+	long lastIdx = G.vertices3[path.back()].contourIdx;
 	gmod::vector3<float> last = contour[lastIdx].pos;
 	last = gmod::vector3<float>(last.x(), last.y() - lowerValContour, last.z());
 	fullPath.push_back(last);
 
-	long n = contour.size();
-	long overlapStart = (lastIdx + 1) % n;
-	long overlapEnd = lastIdx;
-
-	for (long k = overlapStart; k != overlapEnd; k = (k + 1) % n) {
+	const size_t n = contourXZ.Size();
+	for (size_t k : contourXZ.Forward((lastIdx + 1) % n, (lastIdx + n - 1) % n)) {
 		fullPath.push_back(
 			gmod::vector3<float>(contour[k].pos.x(), contour[k].pos.y() - lowerValContour, contour[k].pos.z())
 		);
@@ -451,7 +630,19 @@ void StageThree::Combine(std::vector<InterPoint>& finalContour, const std::vecto
 	}
 }
 
-SegmentGraph StageThree::CutSurfaceIntoGraph(Intersection& intersection, const std::vector<InterPoint>& contour, const Intersection::InterParams& cuttingParams,
+BSurface::Plane StageThree::MakeBase() const {
+	gmod::vector3<double> baseCentre(centre.x(), centre.y() + m_radius, centre.z());
+	return BSurface::MakePlane(baseCentre, width, length, { 0,0,0 }, -69);
+}
+
+BSurface::Plane StageThree::MakeKnife(float YRotation) const {
+	float knifeWidth = std::max(width, length);
+	float knifeHeight = totalHeight - m_offsetBaseY + m_radius; // add radius to a little below
+
+	return BSurface::MakePlane(centre, knifeWidth, knifeHeight, gmod::vector3<double>(90, YRotation, 0), -420);
+}
+
+SegmentGraph StageThree::CutSurfaceIntoGraph(Intersection& intersection, BSurface::Plane* knife, const std::vector<InterPoint>& contour, const Contour& contourXZ, const Intersection::InterParams& cuttingParams,
 	const Intersection::IDIG& part, float epsilon, float YRotation, int cuttingDir, SegmentEnd3& startingPoint) const {
 
 	// find starting point
@@ -464,8 +655,6 @@ SegmentGraph StageThree::CutSurfaceIntoGraph(Intersection& intersection, const s
 	const float separation = diameter - epsilon * m_radius;
 
 	// == starting point and move vector ==
-	constexpr float FLOAT_MAX = std::numeric_limits<float>::max();
-
 	float radY = gmod::deg2rad(YRotation);
 	if (cuttingDir == 1) {
 		radY += DirectX::XM_PIDIV2;
@@ -475,53 +664,11 @@ SegmentGraph StageThree::CutSurfaceIntoGraph(Intersection& intersection, const s
 	gmod::vector3<double> moveDir(std::cos(radY), 0, -std::sin(radY));  // flip Z
 	moveDir.normalize();
 
-	float minX = FLOAT_MAX;
-	long minXidx = 0;
-	float maxX = -FLOAT_MAX;
-	long maxXidx = 0;
-	float minZ = FLOAT_MAX;
-	long minZidx = 0;
-	float maxZ = -FLOAT_MAX;
-	long maxZidx = 0;
-	for (long i = 0; i < contour.size(); i++) {
-		const auto& p = contour[i];
-		if (p.pos.x() < minX) {
-			minX = p.pos.x();
-			minXidx = i;
-		}
-		if (p.pos.x() > maxX) {
-			maxX = p.pos.x();
-			maxXidx = i;
-		}
-		if (p.pos.z() < minZ) {
-			minZ = p.pos.z();
-			minZidx = i;
-		}
-		if (p.pos.z() > maxZ) {
-			maxZ = p.pos.z();
-			maxZidx = i;
-		}
-	}
-
-	const float midX = (minX + maxX) / 2;
-	const float midZ = (minZ + maxZ) / 2;
-
-	float minProj = FLOAT_MAX;
-	float maxProj = -FLOAT_MAX;
-	long startIdx = 0;
-
-	for (long i = 0; i < contour.size(); i++) {
-		const auto& p = contour[i];
-		float proj = p.pos.x() * moveDir.x() + p.pos.z() * moveDir.z();
-
-		if (proj < minProj) {
-			minProj = proj;
-			startIdx = i;
-		}
-		if (proj > maxProj) {
-			maxProj = proj;
-		}
-	}
+	// the cuts sweep the contour along the move direction, from its first point to its last one
+	const long startIdx = contourXZ.Extreme({ static_cast<float>(-moveDir.x()), static_cast<float>(-moveDir.z()) });
+	const Point2& last = contourXZ[contourXZ.Extreme({ static_cast<float>(moveDir.x()), static_cast<float>(moveDir.z()) })];
+	const float minProj = contourXZ[startIdx].x * moveDir.x() + contourXZ[startIdx].z * moveDir.z();
+	const float maxProj = last.x * moveDir.x() + last.z * moveDir.z();
 
 	int ID = 0;
 	startingPoint = SegmentEnd3{ .id = ID };
@@ -560,142 +707,120 @@ SegmentGraph StageThree::CutSurfaceIntoGraph(Intersection& intersection, const s
 	startingPoint.contourIdx = startIdx;
 	// =====
 
-	float knifeWidth = std::max(width, length);
-	float knifeHeight = totalHeight - m_offsetBaseY + m_radius; // add radius to a little below
 	float knifeY = (totalHeight + m_offsetBaseY) / 2.f;
 
-	BSurface::Plane knife = BSurface::MakePlane(centre, knifeWidth, knifeHeight, gmod::vector3<double>(90, YRotation, 0), -420);
-
 	std::vector<Segment3> innerSegements;
 	std::vector<SegmentEnd3> contourIntersections;
 
+	// contour is the same for every cut, its containment queries share one index
+	// the crossings with it are searched in the cells of its UV segment grid
+	const Contour contourUV(PointsUV(contour), m_uvGridMargin);
+	const PolygonIndex contourIndex(contourUV.Points());
+
+	const float midX = (contourXZ.Min().x + contourXZ.Max().x) / 2;
+	const float midZ = (contourXZ.Min().z + contourXZ.Max().z) / 2;
 	const float midProj = moveDir.x() * midX + moveDir.z() * midZ;
 	float currVal = startVal + step;
 	//int dirSign = step > 0 ? 1 : -1;
-	while (currVal < endVal) {
-		/*float valX, valZ;
-		if (YRotation == 0.f) {
-			valX = midX;
-			valZ = currVal;
-		} else {
-			valX = currVal;
-			valZ = midZ;
-		}*/
-		float thisCurrVal;
-
-		thisCurrVal = currVal;
-		for (int t = 0; t <= 3; t++) {
-			const float delta = thisCurrVal - midProj;
-			const float valX = midX + moveDir.x() * delta;
-			const float valZ = midZ + moveDir.z() * delta;
-
-			knife.surface->SetTranslation(valX, knifeY, valZ);
-
-			Intersection::IDIG knifeIDIG = { knife.surface->id, dynamic_cast<IGeometrical*>(knife.surface.get()) };
-
-			intersection.SetIntersectionParameters(cuttingParams);
-			unsigned int res = intersection.FindIntersection(std::make_pair(part, knifeIDIG));
-
-			if (res == 1) { // fallback - try to use middle of knife as a hint
-				intersection.cursorPosition = gmod::vector3<double>(valX, m_offsetBaseY, valZ);
-				intersection.useCursorAsStart = true;
-				res = intersection.FindIntersection(std::make_pair(part, knifeIDIG));
-				intersection.useCursorAsStart = false;
+	if (m_useIsoLines) {
+		// iso-parameter lines need no cuts at all, they are clipped by the contour like the cut lines
+		for (const auto& isoLine : IsoCutLines(part, separation)) {
+			GetInnerSegments(contour, contourUV, contourIndex, isoLine, innerSegements, contourIntersections, ID, part);
+		}
+	} else if (m_usePlaneSection) {
+		std::vector<std::vector<StageThree::InterPoint>> cutLines;
+		if (m_useScallopStep) {
+			// every cut decides how far the next one goes, so they are found one by one
+			while (currVal < endVal) {
+				cutLines.push_back(PlaneCutLine(part, moveDir, currVal));
+				currVal += cutLines.back().empty() ? step : ScallopStep(cutLines.back(), moveDir);
 			}
-			if (res != 0) {
-				thisCurrVal -= step * (t * 0.25f);
-				continue;
+		} else {
+			// cuts are independent plane sections, computed in parallel and added to the graph in order
+			std::vector<float> cutValues;
+			for (; currVal < endVal; currVal += step) {
+				cutValues.push_back(currVal);
 			}
-			break;
+
+			cutLines.resize(cutValues.size());
+			Parallel::For(0, static_cast<int>(cutValues.size()), [&](int k) {
+				cutLines[k] = PlaneCutLine(part, moveDir, cutValues[k]);
+			});
 		}
 
-		thisCurrVal = currVal;
-		for (int t = 0; t <= 3; t++) {
-			const float delta = thisCurrVal - midProj;
-			const float valX = midX + moveDir.x() * delta;
-			const float valZ = midZ + moveDir.z() * delta;
+		for (const auto& intersectionLine : cutLines) {
+			GetInnerSegments(contour, contourUV, contourIndex, intersectionLine, innerSegements, contourIntersections, ID, part);
+		}
+	} else {
+		while (currVal < endVal) {
+			/*float valX, valZ;
+			if (YRotation == 0.f) {
+				valX = midX;
+				valZ = currVal;
+			} else {
+				valX = currVal;
+				valZ = midZ;
+			}*/
+			float thisCurrVal;
 
-			knife.surface->SetTranslation(valX, knifeY, valZ);
+			thisCurrVal = currVal;
+			for (int t = 0; t <= 3; t++) {
+				const float delta = thisCurrVal - midProj;
+				const float valX = midX + moveDir.x() * delta;
+				const float valZ = midZ + moveDir.z() * delta;
 
-			Intersection::IDIG knifeIDIG = { knife.surface->id, dynamic_cast<IGeometrical*>(knife.surface.get()) };
+				knife->surface->SetTranslation(valX, knifeY, valZ);
 
-			intersection.SetIntersectionParameters(cuttingParams);
-			unsigned int res = intersection.FindIntersection(std::make_pair(part, knifeIDIG));
+				Intersection::IDIG knifeIDIG = { knife->surface->id, dynamic_cast<IGeometrical*>(knife->surface.get()) };
 
-			if (res == 1) { // fallback - try to use middle of knife as a hint
-				intersection.cursorPosition = gmod::vector3<double>(valX, m_offsetBaseY, valZ);
-				intersection.useCursorAsStart = true;
-				res = intersection.FindIntersection(std::make_pair(part, knifeIDIG));
-				intersection.useCursorAsStart = false;
-			}
-			if (res != 0) {
-				thisCurrVal += step * (t * 0.25f);
-				continue;
-			}
-			break;
-		}
+				intersection.SetIntersectionParameters(cuttingParams);
+				unsigned int res = intersection.FindIntersection(std::make_pair(part, knifeIDIG));
 
-		auto& pointsOfIntersection = intersection.GetPointsOfIntersection();
-		//std::vector<StageThree::InterPoint> intersectionLine(pointsOfIntersection.size());
-		//std::transform(pointsOfIntersection.begin(), pointsOfIntersection.end(), intersectionLine.begin(),
-		//	[&part](const Intersection::PointOfIntersection& p) {
-		//	auto normal = part.s->Normal(p.uvs.u1, p.uvs.v1);
-		//	return StageThree::InterPoint{
-		//		.pos = gmod::vector3<float>(p.pos.x(), p.pos.y(), p.pos.z()),
-		//		.norm = gmod::vector3<float>(normal.x(), normal.y(), normal.z()),
-		//		.u = static_cast<float>(p.uvs.u1),
-		//		.v = static_cast<float>(p.uvs.v1),
-		//		.surf = part.s
-		//	};
-		//});
-		
-		// the idea here is to skip points below baseY
-		std::vector<StageThree::InterPoint> intersectionLine;
-		std::vector<StageThree::InterPoint> endOfLine;
-		bool switchedToMain = false;
-		for (const auto& poi : pointsOfIntersection) {
-			if (poi.pos.y() < m_offsetBaseY - 1.f) {
-				switchedToMain = true;
-				continue;
+				if (res == 1) { // fallback - try to use middle of knife as a hint
+					intersection.cursorPosition = gmod::vector3<double>(valX, m_offsetBaseY, valZ);
+					intersection.useCursorAsStart = true;
+					res = intersection.FindIntersection(std::make_pair(part, knifeIDIG));
+					intersection.useCursorAsStart = false;
+				}
+				if (res != 0) {
+					thisCurrVal -= step * (t * 0.25f);
+					continue;
+				}
+				break;
 			}
-			auto normal = part.s->Normal(poi.uvs.u1, poi.uvs.v1);
 
-			StageThree::InterPoint ip{
-				.pos = gmod::vector3<float>(poi.pos.x(), poi.pos.y(), poi.pos.z()),
-				.norm = gmod::vector3<float>(normal.x(), normal.y(), normal.z()),
-				.u = static_cast<float>(poi.uvs.u1),
-				.v = static_cast<float>(poi.uvs.v1),
-				.surf = part.s
-			};
+			thisCurrVal = currVal;
+			for (int t = 0; t <= 3; t++) {
+				const float delta = thisCurrVal - midProj;
+				const float valX = midX + moveDir.x() * delta;
+				const float valZ = midZ + moveDir.z() * delta;
 
-			if (switchedToMain) {
-				intersectionLine.push_back(ip);
-			} else {
-				endOfLine.push_back(ip);
-			}
-		}
+				knife->surface->SetTranslation(valX, knifeY, valZ);
 
-		if (!endOfLine.empty()) {
-			intersectionLine.insert(intersectionLine.end(), endOfLine.begin(), endOfLine.end());
-		}
+				Intersection::IDIG knifeIDIG = { knife->surface->id, dynamic_cast<IGeometrical*>(knife->surface.get()) };
 
-		// == filter excess points ==
-		std::vector<InterPoint> filtered;
-		filtered.push_back(intersectionLine.front());
-		for (size_t k = 1; k < intersectionLine.size() - 1; k++) {
-			auto& prev = filtered.back();
-			auto& curr = intersectionLine[k];
-			auto& next = intersectionLine[k + 1];
+				intersection.SetIntersectionParameters(cuttingParams);
+				unsigned int res = intersection.FindIntersection(std::make_pair(part, knifeIDIG));
 
-			if (!AreSimilar(prev, curr, next)) {
-				filtered.push_back(curr);
+				if (res == 1) { // fallback - try to use middle of knife as a hint
+					intersection.cursorPosition = gmod::vector3<double>(valX, m_offsetBaseY, valZ);
+					intersection.useCursorAsStart = true;
+					res = intersection.FindIntersection(std::make_pair(part, knifeIDIG));
+					intersection.useCursorAsStart = false;
+				}
+				if (res != 0) {
+					thisCurrVal += step * (t * 0.25f);
+					continue;
+				}
+				break;
 			}
-		}
-		intersectionLine = filtered;
-		// =====
 
-		GetInnerSegments(contour, intersectionLine, innerSegements, contourIntersections, ID, part);
-		currVal += step;
+			auto& pointsOfIntersection = intersection.GetPointsOfIntersection();
+			std::vector<StageThree::InterPoint> intersectionLine = CreateCutLine(pointsOfIntersection, part);
+
+			GetInnerSegments(contour, contourUV, contourIndex, intersectionLine, innerSegements, contourIntersections, ID, part);
+			currVal += step;
+		}
 	}
 
 	contourIntersections.push_back(startingPoint); // add the additonal starting point to graph
@@ -704,29 +829,218 @@ SegmentGraph StageThree::CutSurfaceIntoGraph(Intersection& intersection, const s
 	});
 
 	std::vector<Segment3> contourSegements;
-	contourSegements.reserve(2 * contourIntersections.size());
+	contourSegements.reserve(contourIntersections.size());
 	for (int j = 0; j < contourIntersections.size(); j++) {
 		int nextJ = (j + 1) % contourIntersections.size();
 
-		Segment3 segForward = {
+		Segment3 seg = {
 			.p1 = contourIntersections[j],
 			.p2 = contourIntersections[nextJ],
 			.contourSegment = true
 		};
-		contourSegements.push_back(segForward);
+		contourSegements.push_back(seg);
+	}
 
-		Segment3 segBackward = {
-			.p1 = contourIntersections[nextJ],
-			.p2 = contourIntersections[j],
-			.contourSegment = true
+	return SegmentGraph(innerSegements, contourSegements);
+}
+
+std::vector<StageThree::InterPoint> StageThree::PlaneCutLine(const Intersection::IDIG& part, const gmod::vector3<double>& moveDir, float value) const {
+	const PlaneSection::Plane plane = { moveDir, value };
+	const auto curves = m_planeSection.Section(part.s, plane);
+
+	// the longest curve goes across the part, it is the one the marcher would follow
+	// refined curves have points spread unevenly, so they are compared by arc length
+	auto arcLength = [](const PlaneSection::Curve& curve) {
+		double length = 0.0;
+		for (size_t k = 1; k < curve.points.size(); k++) {
+			length += (curve.points[k].pos - curve.points[k - 1].pos).length();
+		}
+		return length;
+	};
+	std::vector<double> lengths;
+	lengths.reserve(curves.size());
+	for (const auto& curve : curves) {
+		lengths.push_back(arcLength(curve));
+	}
+	auto longestLength = std::max_element(lengths.begin(), lengths.end());
+	if (longestLength == lengths.end()) { return {}; }
+	auto longest = curves.begin() + (longestLength - lengths.begin());
+
+	std::vector<Intersection::PointOfIntersection> pointsOfIntersection;
+	pointsOfIntersection.reserve(longest->points.size());
+	for (const auto& p : longest->points) {
+		pointsOfIntersection.push_back({ { p.u, p.v, 0, 0 }, p.pos });
+	}
+	return CreateCutLine(pointsOfIntersection, part);
+}
+
+float StageThree::ScallopStep(const std::vector<InterPoint>& cutLine, const gmod::vector3<double>& moveDir) const {
+	const gmod::vector3<float> dir(moveDir.x(), moveDir.y(), moveDir.z());
+	const size_t n = cutLine.size();
+
+	float step = m_maxScallopStep;
+	for (size_t k = 0; k < n; k++) {
+		const auto& p = cutLine[k];
+		const gmod::vector3<float> along = cutLine[std::min(k + 1, n - 1)].pos - cutLine[k > 0 ? k - 1 : 0].pos;
+		if (along.length() < m_minScallopStep) { continue; }
+
+		// next pass lies across the cut, in the tangent plane of the part
+		gmod::vector3<float> across = gmod::cross(p.norm, along).normalized();
+		float cosSlope = gmod::dot(across, dir);
+		if (cosSlope < 0.f) {
+			across = -across;
+			cosSlope = -cosSlope;
+		}
+
+		// normal curvature across the cut, from the change of the normal over a small step
+		// measured on the offset part, which shares the normal and the tangent directions with the milled surface but not its parametric speed
+		gmod::vector3<double> dPu, dPv;
+		Derivatives(p.surf, p.u, p.v, dPu, dPv);
+		const auto normal = p.surf->Normal(p.u, p.v);
+		const gmod::vector3<double> t(across.x(), across.y(), across.z());
+		const double uu = gmod::dot(dPu, dPu), uv = gmod::dot(dPu, dPv), vv = gmod::dot(dPv, dPv);
+		const double det = uu * vv - uv * uv;
+		if (det < 1e-12) { continue; }
+		const double tu = m_curvatureStep * gmod::dot(dPu, t), tv = m_curvatureStep * gmod::dot(dPv, t);
+		const double du = (vv * tu - uv * tv) / det;
+		const double dv = (uu * tv - uv * tu) / det;
+		const auto bounds = p.surf->ParametricBounds();
+		const double u1 = std::clamp(p.u + du, bounds.uMin, bounds.uMax);
+		const double v1 = std::clamp(p.v + dv, bounds.vMin, bounds.vMax);
+		const double offsetCurvature = gmod::dot(p.surf->Normal(u1, v1) - normal, t) / m_curvatureStep;
+
+		// the offset bends less, ko = k / (1 + R k), so the milled surface has k = ko / (1 - R ko)
+		const double denom = 1.0 - m_radius * offsetCurvature;
+		if (denom < 1e-6) { continue; } // sharp convex edge, any step keeps the scallop
+
+		// distance of neighbouring ball centres leaving the scallop height, h = d^2 / (8 R (1 + R k)) for small h,
+		// convex surfaces allow longer steps, concave ones need shorter ones
+		const double curvature = offsetCurvature / denom;
+		const double factor = std::max(1.0 + m_radius * curvature, m_minCurvatureFactor);
+		const float centreStep = static_cast<float>(std::sqrt(8.0 * m_scallopHeight * m_radius * factor));
+		step = std::min(step, centreStep * cosSlope);
+	}
+
+	return std::max(step, m_minScallopStep);
+}
+
+void StageThree::Derivatives(const IGeometrical* surf, double u, double v, gmod::vector3<double>& dPu, gmod::vector3<double>& dPv) const {
+	const auto bounds = surf->ParametricBounds();
+	const double hu = m_derivativeStep * (bounds.uMax - bounds.uMin);
+	const double hv = m_derivativeStep * (bounds.vMax - bounds.vMin);
+
+	const double u0 = std::max(u - hu, bounds.uMin), u1 = std::min(u + hu, bounds.uMax);
+	const double v0 = std::max(v - hv, bounds.vMin), v1 = std::min(v + hv, bounds.vMax);
+	dPu = (surf->Point(u1, v) - surf->Point(u0, v)) * (1.0 / (u1 - u0));
+	dPv = (surf->Point(u, v1) - surf->Point(u, v0)) * (1.0 / (v1 - v0));
+}
+
+std::vector<std::vector<StageThree::InterPoint>> StageThree::IsoCutLines(const Intersection::IDIG& part, float separation) const {
+	const auto bounds = part.s->ParametricBounds();
+	const double rangeU = bounds.uMax - bounds.uMin;
+	const double rangeV = bounds.vMax - bounds.vMin;
+
+	// largest length of a unit parametric step over the milled part, lines spaced by it are never further apart than separation
+	const double du = rangeU / m_isoProbeRes;
+	const double dv = rangeV / m_isoProbeRes;
+	double speedU = 0.0, speedV = 0.0;
+	for (int i = 0; i < m_isoProbeRes; i++) {
+		for (int j = 0; j < m_isoProbeRes; j++) {
+			const double u = bounds.uMin + i * du;
+			const double v = bounds.vMin + j * dv;
+			const auto p = part.s->Point(u, v);
+			const auto pu = part.s->Point(u + du, v);
+			const auto pv = part.s->Point(u, v + dv);
+			if (p.y() < m_offsetBaseY - 1.f) { continue; }
+
+			speedU = std::max(speedU, (pu - p).length() / du);
+			speedV = std::max(speedV, (pv - p).length() / dv);
+		}
+	}
+
+	// lines of constant u or v, whichever needs fewer of them
+	const bool constU = rangeU * speedU <= rangeV * speedV;
+	const double lineRange = constU ? rangeU : rangeV;
+	const double alongRange = constU ? rangeV : rangeU;
+	const double lineSpeed = constU ? speedU : speedV;
+	const double alongSpeed = constU ? speedV : speedU;
+
+	const int numLines = static_cast<int>(std::ceil(lineRange * lineSpeed / separation));
+	const int numSamples = std::max(2, static_cast<int>(std::ceil(alongRange * alongSpeed / m_isoSegment)));
+
+	std::vector<std::vector<StageThree::InterPoint>> isoLines(std::max(0, numLines - 1));
+	Parallel::For(1, numLines, [&](int k) {
+		const double iso = (constU ? bounds.uMin : bounds.vMin) + k * lineRange / numLines;
+
+		std::vector<Intersection::PointOfIntersection> pointsOfIntersection;
+		pointsOfIntersection.reserve(numSamples + 1);
+		for (int j = 0; j <= numSamples; j++) {
+			const double along = (constU ? bounds.vMin : bounds.uMin) + j * alongRange / numSamples;
+			const double u = constU ? iso : along;
+			const double v = constU ? along : iso;
+			pointsOfIntersection.push_back({ { u, v, 0, 0 }, part.s->Point(u, v) });
+		}
+		isoLines[k - 1] = CreateCutLine(pointsOfIntersection, part);
+	});
+
+	return isoLines;
+}
+
+std::vector<StageThree::InterPoint> StageThree::CreateCutLine(const std::vector<Intersection::PointOfIntersection>& pointsOfIntersection,
+	const Intersection::IDIG& part) const {
+
+	// the idea here is to skip points below baseY
+	std::vector<StageThree::InterPoint> intersectionLine;
+	std::vector<StageThree::InterPoint> endOfLine;
+	bool switchedToMain = false;
+	for (const auto& poi : pointsOfIntersection) {
+		if (poi.pos.y() < m_offsetBaseY - 1.f) {
+			switchedToMain = true;
+			continue;
+		}
+		auto normal = part.s->Normal(poi.uvs.u1, poi.uvs.v1);
+
+		StageThree::InterPoint ip{
+			.pos = gmod::vector3<float>(poi.pos.x(), poi.pos.y(), poi.pos.z()),
+			.norm = gmod::vector3<float>(normal.x(), normal.y(), normal.z()),
+			.u = static_cast<float>(poi.uvs.u1),
+			.v = static_cast<float>(poi.uvs.v1),
+			.surf = part.s
 		};
-		contourSegements.push_back(segBackward);
+
+		if (switchedToMain) {
+			intersectionLine.push_back(ip);
+		} else {
+			endOfLine.push_back(ip);
+		}
 	}
 
-	return SegmentGraph(innerSegements, contourSegements);
+	if (!endOfLine.empty()) {
+		intersectionLine.insert(intersectionLine.end(), endOfLine.begin(), endOfLine.end());
+	}
+
+	if (intersectionLine.empty()) {
+		return intersectionLine;
+	}
+
+	// == filter excess points ==
+	std::vector<InterPoint> filtered;
+	filtered.push_back(intersectionLine.front());
+	for (size_t k = 1; k < intersectionLine.size() - 1; k++) {
+		auto& prev = filtered.back();
+		auto& curr = intersectionLine[k];
+		auto& next = intersectionLine[k + 1];
+
+		if (!AreSimilar(prev, curr, next)) {
+			filtered.push_back(curr);
+		}
+	}
+	// =====
+
+	return filtered;
 }
 
-void StageThree::GetInnerSegments(const std::vector<InterPoint>& contour, const std::vector<InterPoint>& intersectionLine,
+void StageThree::GetInnerSegments(const std::vector<InterPoint>& contour, const Contour& contourUV, const PolygonIndex& contourIndex, const std::vector<InterPoint>& intersectionLine,
 	std::vector<Segment3>& innerSegements, std::vector<SegmentEnd3>& contourIntersections, int& ID, const Intersection::IDIG& part) const {
 
 	if (intersectionLine.empty()) {
@@ -742,12 +1056,15 @@ void StageThree::GetInnerSegments(const std::vector<InterPoint>& contour, const
 	int n = contour.size();
 	int m = intersectionLine.size();
 
+	// only contour segments near the line segment can cross it, they come in increasing order like in a full scan
+	std::vector<int> candidates;
 	for (long j = 0; j < m - 1; j++) {
 		auto& A = intersectionLine[j];
 		long nextJ = j + 1; // assume open
 		auto& B = intersectionLine[nextJ];
 
-		for (long i = 0; i < n; i++) {
+		contourUV.Grid().Candidates({ A.u, A.v }, { B.u, B.v }, candidates);
+		for (long i : candidates) {
 			auto& C = contour[i];
 			long nextI = (i + 1) % n; // assume closed
 			auto& D = contour[nextI];
@@ -783,12 +1100,19 @@ void StageThree::GetInnerSegments(const std::vector<InterPoint>& contour, const
 	//}
 	// =====
 
+	// midpoints of all pieces between consecutive crossings are tested at once
+	std::vector<Point2> midpoints;
+	midpoints.reserve(intersections.size() - 1);
+	for (int k = 0; k < intersections.size() - 1; k++) {
+		int midJ = (intersections[k].j + intersections[k + 1].j) / 2;
+		midpoints.push_back({ intersectionLine[midJ].u, intersectionLine[midJ].v });
+	}
+	const std::vector<int> windings = contourIndex.Windings(midpoints);
+
 	for (int k = 0; k < intersections.size() - 1; k++) {
 		int nextK = k + 1;
-		int midJ = (intersections[k].j + intersections[nextK].j) / 2;
-		const InterPoint& midpoint = intersectionLine[midJ];
 
-		if (IsInside(PartUVs{ midpoint.u, midpoint.v }, contour)) {
+		if (windings[k] != 0) {
 			SegmentEnd3 start = {
 				.id = ID,
 				.contourIdx = intersections[k].i
@@ -819,22 +1143,14 @@ void StageThree::GetInnerSegments(const std::vector<InterPoint>& contour, const
 			auto p2 = part.s->Point(intersections[nextK].u, intersections[nextK].v);
 			innerPoints.push_back(gmod::vector3<float>(p2.x(), p2.y(), p2.z()));
 
-			Segment3 segForward = {
+			// the graph adds the reversed edge sharing the points
+			Segment3 seg = {
 				.p1 = start,
 				.p2 = end,
 				.contourSegment = false,
-				.p1p2 = innerPoints
+				.p1p2 = std::move(innerPoints)
 			};
-			innerSegements.push_back(segForward);
-
-			std::reverse(innerPoints.begin(), innerPoints.end());
-			Segment3 segBackward = {
-				.p1 = end,
-				.p2 = start,
-				.contourSegment = false,
-				.p1p2 = innerPoints
-			};
-			innerSegements.push_back(segBackward);
+			innerSegements.push_back(std::move(seg));
 		}
 	}
 }
@@ -932,6 +1248,15 @@ bool StageThree::IsInside(const PartUVs& point, const std::vector<StageThree::In
 	return winding != 0;
 }
 
+std::vector<Point2> StageThree::PointsUV(const std::vector<StageThree::InterPoint>& closedContour) const {
+	std::vector<Point2> points;
+	points.reserve(closedContour.size());
+	for (const auto& p : closedContour) {
+		points.push_back({ p.u, p.v }); // u along x, v along z
+	}
+	return points;
+}
+
 bool StageThree::AreSimilar(const InterPoint& a, const InterPoint& b, const InterPoint& c) const {
 	gmod::vector3<float> ab = b.pos - a.pos;
 	gmod::vector3<float> ac = c.pos - a.pos;
@@ -1,6 +1,10 @@
 #pragma once
 #include "Object.h"
+#include "BSurface.h"
+#include "Contour.h"
 #include "Intersection.h"
+#include "PlaneSection.h"
+#include "PolygonIndex.h"
 #include "SegmentGraph.h"
 
 namespace app {
@@ -19,12 +23,79 @@ namespace app {
 		const gmod::vector3<double> centre = { 0, baseY, 0 };
 
 		std::vector<gmod::vector3<float>> GeneratePath(const std::vector<std::unique_ptr<Object>>& sceneObjects, Intersection& intersection) const;
+
+		// values tried for one part, an empty list keeps the configured value
+		// values of parameters the active cutting mode ignores are rejected
+		struct SweepRange {
+			std::string name;
+			std::vector<float> epsilons;
+			std::vector<float> YRotations;
+			std::vector<int> cuttingDirs;
+			std::vector<int> maxIntersectionPoints; // mip of the cutting params
+			std::vector<std::pair<std::string, std::vector<gmod::vector3<double>>>> cursorSeeds; // per intersecting surface using the cursor
+		};
+
+		struct SweepResult {
+			std::string name;
+			float epsilon;
+			float YRotation;
+			int cuttingDir;
+			int maxIntersectionPoints;
+			std::vector<std::pair<std::string, gmod::vector3<double>>> cursorSeeds;
+
+			bool success = false;
+			std::string error;
+			float pathLength = 0.f;
+			double seconds = 0.0;
+		};
+
+		const std::vector<SweepRange> sweepRanges = {
+			{ "earL", { 1.6f, 1.7f, 1.8f }, {}, { 1, 2 } },
+			{ "earR", { 1.6f, 1.7f, 1.8f }, {}, { 1, 2 } },
+			{ "head", { 1.6f, 1.7f, 1.8f }, {}, { 1, 2 } },
+			{ "tail", { 1.6f, 1.7f, 1.8f }, {}, { 1, 2 } },
+			{ "legBL", { 1.6f, 1.7f, 1.8f }, {}, { 1, 2 } },
+			{ "legFL", { 1.6f, 1.7f, 1.8f }, {}, { 1, 2 } },
+			{ "legFR", { 1.6f, 1.7f, 1.8f }, {}, { 1, 2 } },
+			{ "legBR", { 1.6f, 1.7f, 1.8f }, {}, { 1, 2 } },
+			{ "body", { 1.6f, 1.7f, 1.8f }, {}, { 1, 2 } }
+		};
+
+		// runs the part pipeline for every combination of the ranges in parallel, without touching the scene
+		// blocks the caller until every combination is done
+		// results are grouped by part in order of the ranges, the successful ones first by path length
+		std::vector<SweepResult> Sweep(const std::vector<std::unique_ptr<Object>>& sceneObjects, const std::vector<SweepRange>& ranges) const;
+		std::string SweepReport(const std::vector<SweepResult>& results) const;
 	private:
 		const float FZERO = 1e-2 * std::numeric_limits<float>::epsilon();
 		const float FZERO_UV = 1e-6 * std::numeric_limits<float>::epsilon();
 		const float m_radius = 4.f;
 		const int m_samplingRes = 500;
 		const float m_offsetBaseY = baseY + m_radius;
+		// covers the tolerance of DoSegementsCross when looking for contour segments near a cut in UV
+		const float m_uvGridMargin = 1e-4f;
+		// cutting lines as plane sections of the part, otherwise the knife surface is intersected with it
+		const bool m_usePlaneSection = true;
+		const PlaneSection m_planeSection;
+		// distance between the cuts from the scallop height left between them, otherwise the part separation is used
+		const bool m_useScallopStep = false;
+		const float m_scallopHeight = 0.05f;
+		const float m_minScallopStep = 0.1f;
+		const float m_maxScallopStep = m_radius;
+		// length of the step over which the normal curvature is measured
+		const double m_curvatureStep = 1e-2;
+		// parametric step of the numerical derivatives, relative to the parametric range
+		const double m_derivativeStep = 1e-4;
+		// keeps the step positive on concave parts curved more tightly than the tool
+		const double m_minCurvatureFactor = 0.1;
+		// finishing along iso-parameter lines of the part, no cuts are computed then
+		const bool m_useIsoLines = false;
+		// the knife surface and the cutting params are used only when neither plane sections nor iso lines are
+		const bool m_useKnife = !m_useIsoLines && !m_usePlaneSection;
+		// samples per parametric direction when the speed of the part parametrization is estimated
+		const int m_isoProbeRes = 64;
+		// largest distance between samples of an iso-parameter line
+		const float m_isoSegment = 0.1f;
 
 		const Intersection::InterParams m_baseInterParams = {
 			.gs = 1 * 1e-3,
@@ -181,7 +252,7 @@ namespace app {
 
 		std::vector<gmod::vector3<float>> GeneratePathForPart(
 			const std::vector<std::unique_ptr<Object>>& sceneObjects, Intersection& intersection,
-			const MillingPartParams& params, const Intersection::IDIG& base) const;
+			const MillingPartParams& params, const Intersection::IDIG& base, BSurface::Plane* knife) const;
 
 		std::vector<InterPoint> FindContour(Intersection& intersection,
 			const std::vector<InterPoint>& baseContour, const gmod::vector3<float>& insidePoint,
@@ -190,10 +261,29 @@ namespace app {
 		void Combine(std::vector<InterPoint>& finalContour, const std::vector<InterPoint>& intersectionLine,
 			float insideU, float insideV, const Intersection::IDIG& part) const;
 		
-		SegmentGraph CutSurfaceIntoGraph(Intersection& intersection, const std::vector<InterPoint>& contour, const Intersection::InterParams& cuttingParams,
+		// plane the contours of the parts lie on, raised by the radius
+		BSurface::Plane MakeBase() const;
+		// vertical plane cutting the part, moved along the cuts
+		BSurface::Plane MakeKnife(float YRotation) const;
+
+		// knife is needed only with m_useKnife, it may be nullptr otherwise
+		SegmentGraph CutSurfaceIntoGraph(Intersection& intersection, BSurface::Plane* knife, const std::vector<InterPoint>& contour, const Contour& contourXZ, const Intersection::InterParams& cuttingParams,
 			const Intersection::IDIG& part, float epsilon, float YRotation, int cuttingDir, SegmentEnd3& startingPoint) const;
 
-		void GetInnerSegments(const std::vector<InterPoint>& contour, const std::vector<InterPoint>& intersectionLine,
+		// longest section of the part with the plane at the value along the move direction
+		std::vector<InterPoint> PlaneCutLine(const Intersection::IDIG& part, const gmod::vector3<double>& moveDir, float value) const;
+		// distance along the move direction to the next cut, so the scallops left between them are not higher than m_scallopHeight
+		float ScallopStep(const std::vector<InterPoint>& cutLine, const gmod::vector3<double>& moveDir) const;
+		// partial derivatives of the point by central differences, one-sided at the parametric boundary
+		// Tangent returns them normalized, which loses the speed of the parametrization
+		void Derivatives(const IGeometrical* surf, double u, double v, gmod::vector3<double>& dPu, gmod::vector3<double>& dPv) const;
+
+		// lines of constant u or v across the part, not further apart than separation
+		std::vector<std::vector<InterPoint>> IsoCutLines(const Intersection::IDIG& part, float separation) const;
+
+		std::vector<InterPoint> CreateCutLine(const std::vector<Intersection::PointOfIntersection>& pointsOfIntersection, const Intersection::IDIG& part) const;
+
+		void GetInnerSegments(const std::vector<InterPoint>& contour, const Contour& contourUV, const PolygonIndex& contourIndex, const std::vector<InterPoint>& intersectionLine,
 			std::vector<Segment3>& innerSegements, std::vector<SegmentEnd3>& contourIntersections, int& ID, const Intersection::IDIG& part) const;
 
 		struct PartUVs {
@@ -201,6 +291,7 @@ namespace app {
 		};
 		bool DoSegementsCross(PartUVs A, PartUVs B, PartUVs C, PartUVs D, PartUVs& intersection) const;
 		bool IsInside(const PartUVs& point, const std::vector<StageThree::InterPoint>& closedContour) const;
+		std::vector<Point2> PointsUV(const std::vector<StageThree::InterPoint>& closedContour) const;
 
 		bool AreSimilar(const InterPoint& a, const InterPoint& b, const InterPoint& c) const;
 	};
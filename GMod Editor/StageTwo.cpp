@@ -2,6 +2,9 @@
 #include "BSurface.h"
 #include "IGeometrical.h"
 #include "Helper.h"
+#include "Parallel.h"
+#include "SegmentGrid.h"
+#include "EdgeTable.h"
 
 using namespace app;
 
@@ -36,7 +39,7 @@ std::vector<gmod::vector3<float>> StageTwo::GeneratePath(const std::vector<std::
 	}
 	xValues.push_back(xCurr); // last additional
 
-	auto offsetContour = CreateOffsetContour(sceneObjects, intersection);
+	auto offsetContour = CreateOffsetContour(sceneObjects);
 
 	// == filter excess points ==
 	std::vector<InterPoint> filtered;
@@ -53,71 +56,68 @@ std::vector<gmod::vector3<float>> StageTwo::GeneratePath(const std::vector<std::
 	offsetContour = filtered;
 	// =====
 
-	std::unordered_map<float, std::vector<SegmentEnd2>> xValIntersectionPoints;
-	for (const float& xVal : xValues) {
-		xValIntersectionPoints.insert({ xVal, std::vector<SegmentEnd2>() });
+	// contour lies at baseY, the path is built on its XZ projection
+	std::vector<Point2> contourPoints;
+	contourPoints.reserve(offsetContour.size());
+	for (const auto& p : offsetContour) {
+		contourPoints.push_back({ p.pos.x(), p.pos.z() });
 	}
+	const Contour contour(std::move(contourPoints), m_gridMargin);
 
-	float topCountourZ = zBottom;
-	int topCountourIdx = 0;
-
-	int ID = 0; // future vertex index
-	std::vector<SegmentEnd2> contourIntersections;
-	for (size_t i = 0; i < offsetContour.size(); i++) {
-		if (offsetContour[i].pos.z() < topCountourZ) {
-			topCountourZ = offsetContour[i].pos.z();
-			topCountourIdx = i;
-		}
-
-		long long idx1 = i;
-		long long idx2 = (i + 1) % offsetContour.size();
-
-		const auto& p1 = offsetContour[idx1];
-		const auto& p2 = offsetContour[idx2];
-
-		for (const float& xVal : xValues) {
-			// check if this segment crosses any xVal line
-			if ((p1.pos.x() <= xVal + FZERO && p2.pos.x() >= xVal - FZERO) ||
-				(p1.pos.x() >= xVal - FZERO && p2.pos.x() <= xVal + FZERO)) {
-
-				// calculate intersection point (linear interpolation)
-				float t = (xVal - p1.pos.x()) / (p2.pos.x() - p1.pos.x());
-				float z = p1.pos.z() + t * (p2.pos.z() - p1.pos.z());
-
-				SegmentEnd2 p = {
-					.x = xVal,
-					.z = z,
-					.isTopOrBottom = false,
-					.isOnContour = true,
-					.id = ID,
-					.prevIdx = idx1,
-					.nextIdx = idx2
-				};
-				ID++;
-
-				contourIntersections.push_back(p);
-				xValIntersectionPoints[xVal].push_back(p);
-				break; 
-			}
-		}
+	if (m_useSpiralPocketing) {
+		return SpiralPath(contour, { xLeft, zTop }, { xRight, zBottom }, separation);
 	}
 
-	// verify vertical intersections and sort them
-	for (const float& xVal : xValues) {
-		auto& intersections = xValIntersectionPoints.at(xVal);
+	// crossings of every xVal line with the contour, found in one sweep and already sorted along z
+	const EdgeTable edgeTable(contour.Points(), FZERO);
+	const auto lineCrossings = edgeTable.Sweep(xValues);
 
-		if (intersections.size() % 2 != 0) {
+	// crossings in order along the contour get the future vertex indices
+	struct ContourCrossing {
+		EdgeTable::Crossing crossing;
+		size_t line, pos;
+	};
+	std::vector<ContourCrossing> alongContour;
+	std::vector<std::vector<SegmentEnd2>> xValIntersectionPoints(xValues.size());
+	for (size_t l = 0; l < lineCrossings.size(); l++) {
+		if (lineCrossings[l].size() % 2 != 0) {
 			throw std::runtime_error("The number of points for each xVal should be even.");
 		}
+		for (size_t k = 0; k < lineCrossings[l].size(); k++) {
+			alongContour.push_back({ lineCrossings[l][k], l, k });
+		}
+		xValIntersectionPoints[l].resize(lineCrossings[l].size());
+	}
+	std::sort(alongContour.begin(), alongContour.end(), [](const ContourCrossing& c1, const ContourCrossing& c2) {
+		return c1.crossing.edge < c2.crossing.edge || (c1.crossing.edge == c2.crossing.edge && c1.crossing.t < c2.crossing.t);
+	});
 
-		std::sort(intersections.begin(), intersections.end(), [](const SegmentEnd2& a, const SegmentEnd2& b) {
-			return a.z < b.z;
-		});
+	int ID = 0; // future vertex index
+	std::vector<SegmentEnd2> contourIntersections;
+	for (const auto& [c, line, pos] : alongContour) {
+		const long long idx1 = c.edge;
+		const long long idx2 = (c.edge + 1) % offsetContour.size();
+
+		SegmentEnd2 p = {
+			.x = xValues[line],
+			.z = c.z,
+			.isTopOrBottom = false,
+			.isOnContour = true,
+			.id = ID,
+			.prevIdx = idx1,
+			.nextIdx = idx2
+		};
+		ID++;
+
+		contourIntersections.push_back(p);
+		xValIntersectionPoints[line][pos] = p; // same place as in the sweep, so sorted along z
 	}
 
-	// create vertical segments
+	// create vertical segments, they are sorted in regard to x as the xVals are
 	std::vector<std::pair<float, std::vector<Segment2>>> verticalSegments;
-	for (auto& [xVal, ends] : xValIntersectionPoints) {
+	for (size_t line = 0; line < xValues.size(); line++) {
+		const float xVal = xValues[line];
+		const auto& ends = xValIntersectionPoints[line];
 		verticalSegments.push_back(std::make_pair(xVal, std::vector<Segment2>()));
 
 		SegmentEnd2 top = {
@@ -149,12 +149,6 @@ std::vector<gmod::vector3<float>> StageTwo::GeneratePath(const std::vector<std::
 		}
 	}
 
-	// make sure vertical segments are sorted in regard to x
-	std::sort(verticalSegments.begin(), verticalSegments.end(),
-		[](const std::pair<float, std::vector<Segment2>>& a, const std::pair<float, std::vector<Segment2>>& b) {
-		return a.first < b.first;
-	});
-
 	// create contour segements
 	std::vector<Segment2> contourSegements;
 	contourSegements.reserve(contourIntersections.size());
@@ -164,19 +158,22 @@ std::vector<gmod::vector3<float>> StageTwo::GeneratePath(const std::vector<std::
 
 		Segment2 seg = {
 			.p1 = contourIntersections[idx1],
-			.p2 = contourIntersections[idx2],
-			.interStartIdx = contourIntersections[idx1].nextIdx,
-			.interEndIdx = contourIntersections[idx2].prevIdx
+			.p2 = contourIntersections[idx2]
 		};
+		// crossings on the same contour segment have no contour points between them
+		if (contourIntersections[idx1].prevIdx != contourIntersections[idx2].prevIdx) {
+			seg.interStartIdx = contourIntersections[idx1].nextIdx;
+			seg.interEndIdx = contourIntersections[idx2].prevIdx;
+		}
 
 		contourSegements.push_back(seg);
 	}
 
 	SegmentGraph G(verticalSegments, contourSegements, ID);
-	return GetFinalPath(G, verticalSegments.front().second.front().p1, offsetContour, topCountourIdx, zTop);
+	return GetFinalPath(G, verticalSegments.front().second.front().p1, contour, zTop);
 }
 
-std::vector<StageTwo::InterPoint> StageTwo::CreateOffsetContour(const std::vector<std::unique_ptr<Object>>& sceneObjects, Intersection& intersection) const {
+std::vector<StageTwo::InterPoint> StageTwo::CreateOffsetContour(const std::vector<std::unique_ptr<Object>>& sceneObjects) const {
 	// get all surfaces on scene
 	std::vector<std::pair<Intersection::IDIG, Intersection::InterParams>> sceneSurfaces(m_numOfSurfaces);
 
@@ -190,105 +187,192 @@ std::vector<StageTwo::InterPoint> StageTwo::CreateOffsetContour(const std::vecto
 		}
 	}
 
+	if (m_usePolygonOffset) {
+		// the outline at the base needs only plane sections of the surfaces
+		const PlaneSection::Plane basePlane = { { 0, 1, 0 }, baseY };
+		std::vector<PolygonClipper::Paths> surfaceSections(m_numOfSurfaces);
+		std::vector<char> openSections(m_numOfSurfaces, 0);
+		Parallel::For(0, m_numOfSurfaces, [&](int k) {
+			for (const auto& curve : m_planeSection.Section(sceneSurfaces[k].first.s, basePlane)) {
+				if (!curve.closed) {
+					openSections[k] = 1;
+				}
+				PolygonClipper::Path section;
+				section.reserve(curve.points.size());
+				for (const auto& p : curve.points) {
+					section.push_back({ static_cast<float>(p.pos.x()), static_cast<float>(p.pos.z()) });
+				}
+				surfaceSections[k].push_back(section);
+			}
+		});
+
+		// an open section ends on the parametric boundary, closing it with a chord would corrupt the outline
+		// such surfaces are left to the intersections with the base, which trim their ends
+		if (std::find(openSections.begin(), openSections.end(), 1) == openSections.end()) {
+			PolygonClipper::Paths sections;
+			for (const auto& paths : surfaceSections) {
+				sections.insert(sections.end(), paths.begin(), paths.end());
+			}
+			return PolygonOffsetContour(sections);
+		}
+	}
+
 	// create base
 	BSurface::Plane base = BSurface::MakePlane(centre, width, length, { 0,0,0 }, -69);
 	Intersection::IDIG baseIDIG = { base.surface->id, dynamic_cast<IGeometrical*>(base.surface.get()) };
 
-	std::vector<StageTwo::InterPoint> offsetCountour;
-	for (auto& [surf, params] : sceneSurfaces) {
-		intersection.SetIntersectionParameters(params);
-		unsigned int res = intersection.FindIntersection(std::make_pair(surf, baseIDIG));
+	// sections with the base are independent, every surface gets its own solver
+	// solvers are created here, objects should not be constructed on worker threads
+	std::vector<Intersection> solvers(m_numOfSurfaces);
+	std::vector<std::vector<StageTwo::InterPoint>> surfaceContours(m_numOfSurfaces);
+	Parallel::For(0, m_numOfSurfaces, [&](int k) {
+		const auto& [surf, params] = sceneSurfaces[k];
+		Intersection& solver = solvers[k];
+
+		solver.SetIntersectionParameters(params);
+		unsigned int res = solver.FindIntersection(std::make_pair(surf, baseIDIG));
 		if (res != 0) { 
 			throw std::runtime_error("Should have found intersection, but didn't. Evaluate params.");
 		}
 
-		auto& pointsOfIntersection = intersection.GetPointsOfIntersection();
-		std::vector<StageTwo::InterPoint> thisOffsetCountour;
-		thisOffsetCountour.reserve(pointsOfIntersection.size());
+		surfaceContours[k] = OffsetSurfaceContour(solver.GetPointsOfIntersection(), surf.s);
+	});
 
-		//bool closed = intersection.IsClosed();
-		int dir = IsCW(pointsOfIntersection) ? 1 : -1;
+	// merged in the order of surfaces, every next one crosses the already merged ones
+	std::vector<StageTwo::InterPoint> offsetCountour;
+	for (const auto& thisOffsetCountour : surfaceContours) {
+		Combine(offsetCountour, thisOffsetCountour);
+	}
 
-		size_t start = 1;// 0;
-		size_t n = pointsOfIntersection.size() - 1;
+	return offsetCountour;
+}
 
-		//if (!closed) {
-		//	start = 1;
-		//	n = pointsOfIntersection.size() - 1;
-		//}
+std::vector<StageTwo::InterPoint> StageTwo::PolygonOffsetContour(PolygonClipper::Paths sections) const {
+	// every section bounds the inside of its surface, whatever its direction
+	for (auto& section : sections) {
+		if (PolygonClipper::Area(section) < 0) {
+			std::reverse(section.begin(), section.end());
+		}
+	}
 
-		//if (!closed) { // first
-		//	InterPoint offsetPoi{ .surf = surf.s };
-		//	const auto diff = pointsOfIntersection[1].pos - pointsOfIntersection[0].pos;
-		//	gmod::vector3<double> normal(-diff.z() * dir, 0, diff.x() * dir);
-		//	normal.normalize();
-		//	gmod::vector3<double> offsetPos = pointsOfIntersection[0].pos + normal * m_radius;
+	// offset of the union is the union of offsets, holes enclosed by the surfaces are not milled here
+	const PolygonClipper clipper;
+	const PolygonClipper::Paths offset = clipper.Offset(sections, m_contourOffset);
+	auto outer = std::max_element(offset.begin(), offset.end(), [](const PolygonClipper::Path& a, const PolygonClipper::Path& b) {
+		return PolygonClipper::Area(a) < PolygonClipper::Area(b);
+	});
+	if (outer == offset.end()) {
+		throw std::runtime_error("Offset contour is empty.");
+	}
 
-		//	offsetPoi.pos = gmod::vector3<float>(offsetPos.x(), baseY, offsetPos.z());
-		//	offsetPoi.norm = gmod::vector3<float>(normal.x(), 0, normal.z());
-		//	offsetPoi.u = pointsOfIntersection[0].uvs.u1;
-		//	offsetPoi.v = pointsOfIntersection[0].uvs.v1;
+	const int n = outer->size();
+	std::vector<StageTwo::InterPoint> offsetContour;
+	offsetContour.reserve(n);
+	for (int i = 0; i < n; i++) {
+		const Point2& prev = (*outer)[(i + n - 1) % n];
+		const Point2& curr = (*outer)[i];
+		const Point2& next = (*outer)[(i + 1) % n];
+
+		// counterclockwise contour, outward normal points to the right
+		gmod::vector3<float> normal(next.z - prev.z, 0, prev.x - next.x);
+		normal.normalize();
+
+		offsetContour.push_back(InterPoint{
+			.pos = gmod::vector3<float>(curr.x, baseY, curr.z),
+			.norm = normal,
+			.u = 0.f,
+			.v = 0.f,
+			.surf = nullptr
+		});
+	}
+	return offsetContour;
+}
 
-		//	thisOffsetCountour.push_back(offsetPoi);
+std::vector<StageTwo::InterPoint> StageTwo::OffsetSurfaceContour(const std::vector<Intersection::PointOfIntersection>& pointsOfIntersection, 
+	const IGeometrical* surf) const {
+	std::vector<StageTwo::InterPoint> thisOffsetCountour;
+	thisOffsetCountour.reserve(pointsOfIntersection.size());
+
+	//bool closed = intersection.IsClosed();
+	int dir = IsCW(pointsOfIntersection) ? 1 : -1;
+
+	size_t start = 1;// 0;
+	size_t n = pointsOfIntersection.size() - 1;
+
+	//if (!closed) {
+	//	start = 1;
+	//	n = pointsOfIntersection.size() - 1;
+	//}
+
+	//if (!closed) { // first
+	//	InterPoint offsetPoi{ .surf = surf };
+	//	const auto diff = pointsOfIntersection[1].pos - pointsOfIntersection[0].pos;
+	//	gmod::vector3<double> normal(-diff.z() * dir, 0, diff.x() * dir);
+	//	normal.normalize();
+	//	gmod::vector3<double> offsetPos = pointsOfIntersection[0].pos + normal * m_radius;
+
+	//	offsetPoi.pos = gmod::vector3<float>(offsetPos.x(), baseY, offsetPos.z());
+	//	offsetPoi.norm = gmod::vector3<float>(normal.x(), 0, normal.z());
+	//	offsetPoi.u = pointsOfIntersection[0].uvs.u1;
+	//	offsetPoi.v = pointsOfIntersection[0].uvs.v1;
+
+	//	thisOffsetCountour.push_back(offsetPoi);
+	//}
+
+	// TODO : think how to smoothen the offset contour - maybe add some intermidiate points?
+	// it is a little bit jaggy now, but acceptable
+	float offset = m_contourOffset;
+	for (size_t i = start; i < n; i++) {
+		size_t prevI = i - 1;
+		size_t nextI = i + 1;
+
+		//if (closed) {
+			if (i == 0) {
+				prevI = n - 1;
+			}
+			if (i == n - 1) {
+				nextI = 0;
+			}
 		//}
+		const auto& prevP = pointsOfIntersection[prevI];
+		const auto& currP = pointsOfIntersection[i];
+		const auto& nextP = pointsOfIntersection[nextI];
+
+		InterPoint offsetPoi{ .surf = surf };
+		const auto prevCurr = currP.pos - prevP.pos;
+		const auto currNext = nextP.pos - currP.pos;
+		gmod::vector3<double> normalPrev(-prevCurr.z(), 0, prevCurr.x());
+		normalPrev.normalize();
+		gmod::vector3<double> normalNext(-currNext.z(), 0, currNext.x());
+		normalNext.normalize();
+		gmod::vector3<double> normal(dir * (normalPrev.x() + normalNext.x()) / 2, 0, dir * (normalPrev.z() + normalNext.z()) / 2);
+		normal.normalize();
+		gmod::vector3<double> offsetPos = currP.pos + normal * offset;
+
+		offsetPoi.pos = gmod::vector3<float>(offsetPos.x(), baseY, offsetPos.z());
+		offsetPoi.norm = gmod::vector3<float>(normal.x(), 0, normal.z());
+		offsetPoi.u = currP.uvs.u1;
+		offsetPoi.v = currP.uvs.v1;
+
+		thisOffsetCountour.push_back(offsetPoi);
+	}
 
-		// TODO : think how to smoothen the offset contour - maybe add some intermidiate points?
-		// it is a little bit jaggy now, but acceptable
-		float offset = 1.3f * m_radius;
-		for (size_t i = start; i < n; i++) {
-			size_t prevI = i - 1;
-			size_t nextI = i + 1;
-
-			//if (closed) {
-				if (i == 0) {
-					prevI = n - 1;
-				}
-				if (i == n - 1) {
-					nextI = 0;
-				}
-			//}
-			const auto& prevP = pointsOfIntersection[prevI];
-			const auto& currP = pointsOfIntersection[i];
-			const auto& nextP = pointsOfIntersection[nextI];
-
-			InterPoint offsetPoi{ .surf = surf.s };
-			const auto prevCurr = currP.pos - prevP.pos;
-			const auto currNext = nextP.pos - currP.pos;
-			gmod::vector3<double> normalPrev(-prevCurr.z(), 0, prevCurr.x());
-			normalPrev.normalize();
-			gmod::vector3<double> normalNext(-currNext.z(), 0, currNext.x());
-			normalNext.normalize();
-			gmod::vector3<double> normal(dir * (normalPrev.x() + normalNext.x()) / 2, 0, dir * (normalPrev.z() + normalNext.z()) / 2);
-			normal.normalize();
-			gmod::vector3<double> offsetPos = currP.pos + normal * offset;
-
-			offsetPoi.pos = gmod::vector3<float>(offsetPos.x(), baseY, offsetPos.z());
-			offsetPoi.norm = gmod::vector3<float>(normal.x(), 0, normal.z());
-			offsetPoi.u = currP.uvs.u1;
-			offsetPoi.v = currP.uvs.v1;
-
-			thisOffsetCountour.push_back(offsetPoi);
-		}
-
-		//if (!closed) { // last
-		//	InterPoint offsetPoi{ .surf = surf.s };
-		//	const auto diff = pointsOfIntersection[n].pos - pointsOfIntersection[n - 1].pos;
-		//	gmod::vector3<double> normal(-diff.z() * dir, 0, diff.x() * dir);
-		//	normal.normalize();
-		//	gmod::vector3<double> offsetPos = pointsOfIntersection[n].pos + normal * m_radius;
-
-		//	offsetPoi.pos = gmod::vector3<float>(offsetPos.x(), baseY, offsetPos.z());
-		//	offsetPoi.norm = gmod::vector3<float>(normal.x(), 0, normal.z());
-		//	offsetPoi.u = pointsOfIntersection[n].uvs.u1;
-		//	offsetPoi.v = pointsOfIntersection[n].uvs.v1;
+	//if (!closed) { // last
+	//	InterPoint offsetPoi{ .surf = surf };
+	//	const auto diff = pointsOfIntersection[n].pos - pointsOfIntersection[n - 1].pos;
+	//	gmod::vector3<double> normal(-diff.z() * dir, 0, diff.x() * dir);
+	//	normal.normalize();
+	//	gmod::vector3<double> offsetPos = pointsOfIntersection[n].pos + normal * m_radius;
 
-		//	thisOffsetCountour.push_back(offsetPoi);
-		//}
+	//	offsetPoi.pos = gmod::vector3<float>(offsetPos.x(), baseY, offsetPos.z());
+	//	offsetPoi.norm = gmod::vector3<float>(normal.x(), 0, normal.z());
+	//	offsetPoi.u = pointsOfIntersection[n].uvs.u1;
+	//	offsetPoi.v = pointsOfIntersection[n].uvs.v1;
 
-		Combine(offsetCountour, thisOffsetCountour);
-	}
+	//	thisOffsetCountour.push_back(offsetPoi);
+	//}
 
-	return offsetCountour;
+	return thisOffsetCountour;
 }
 
 void StageTwo::Combine(std::vector<StageTwo::InterPoint>& mainContour, const std::vector<StageTwo::InterPoint>& newContour) const {
@@ -312,13 +396,24 @@ void StageTwo::Combine(std::vector<StageTwo::InterPoint>& mainContour, const std
 	int n = mainContour.size();
 	int m = newContour.size();
 
+	// only segments of the new contour lying near a segment of the main one may cross it
+	std::vector<Point2> newPoints;
+	newPoints.reserve(m);
+	for (const auto& p : newContour) {
+		newPoints.push_back({ p.pos.x(), p.pos.z() });
+	}
+	const SegmentGrid newGrid(newPoints, m_gridMargin);
+
 	std::vector<Crossing> intersections;
+	std::vector<int> candidates;
 	for (size_t i = 0; i < n; i++) {
 		auto& A = mainContour[i].pos;
 		size_t nextI = (i + 1) % n;
 		auto& B = mainContour[nextI].pos;
 
-		for (size_t j = 0; j < m; j++) {
+		// candidates are sorted, so the first crossing found is still the one with the smallest j
+		newGrid.Candidates({ A.x(), A.z() }, { B.x(), B.z() }, candidates);
+		for (const int j : candidates) {
 			auto& C = newContour[j].pos;
 			long nextJ = (j + 1) % m;
 			auto& D = newContour[nextJ].pos;
@@ -384,6 +479,7 @@ void StageTwo::Combine(std::vector<StageTwo::InterPoint>& mainContour, const std
 	size_t& j1 = intersections[0].j;
 	size_t& j2 = intersections[1].j;
 
+	// a single query, building an index would cost more than walking the edges once
 	size_t in = (j1 + j2) / 2;
 	bool takeIn = IsOutside(contourJ->at(in), contourI);
 
@@ -446,8 +542,91 @@ void StageTwo::Combine(std::vector<StageTwo::InterPoint>& mainContour, const std
 	mainContour = result;
 }
 
+std::vector<gmod::vector3<float>> StageTwo::SpiralPath(const Contour& offsetContour,
+	const Point2& minCorner, const Point2& maxCorner, float separation) const {
+
+	PolygonClipper::Path contour = offsetContour.Points();
+	if (PolygonClipper::Area(contour) < 0) {
+		std::reverse(contour.begin(), contour.end());
+	}
+
+	// tool centre can go anywhere between the bounds and the contour
+	const PolygonClipper clipper;
+	const PolygonClipper::Path bounds = { minCorner, { maxCorner.x, minCorner.z }, maxCorner, { minCorner.x, maxCorner.z } };
+	const PolygonClipper::Paths region = clipper.Difference({ bounds }, { contour });
+
+	// k-th ring keeps k separations away from the bounds and the contour
+	std::vector<PolygonClipper::Paths> rings = { region };
+	std::vector<float> ringDistances = { 0.f };
+	while (true) {
+		float distance = separation * rings.size();
+		auto ring = clipper.Offset(region, -distance);
+		if (ring.empty()) {
+			// middle left inside the last ring is closer than the tool radius to a ring put halfway
+			distance -= 0.5f * separation;
+			ring = clipper.Offset(region, -distance);
+			if (!ring.empty()) {
+				rings.push_back(std::move(ring));
+				ringDistances.push_back(distance);
+			}
+			break;
+		}
+		rings.push_back(std::move(ring));
+		ringDistances.push_back(distance);
+	}
+
+	gmod::vector3<float> startPoint(centre.x(), totalHeight + 1.0f, centre.z());
+	std::vector<gmod::vector3<float>> finalPath;
+	finalPath.push_back(startPoint);
+
+	// rings are milled from the outside in, loops of a ring in order of the nearest one
+	Point2 current = minCorner;
+	float currentDistance = -1.f;
+	for (size_t k = 0; k < rings.size(); k++) {
+		auto& loops = rings[k];
+		while (!loops.empty()) {
+			size_t bestLoop = 0, bestPoint = 0;
+			float bestLength = std::numeric_limits<float>::max();
+			for (size_t l = 0; l < loops.size(); l++) {
+				for (size_t i = 0; i < loops[l].size(); i++) {
+					const Point2 d = loops[l][i] - current;
+					const float length = std::hypot(d.x, d.z);
+					if (length < bestLength) {
+						bestLength = length;
+						bestLoop = l;
+						bestPoint = i;
+					}
+				}
+			}
+			const PolygonClipper::Path loop = std::move(loops[bestLoop]);
+			loops.erase(loops.begin() + bestLoop);
+			const Point2& entry = loop[bestPoint];
+
+			// points of both rings are far enough from the contour for the tool to go straight between them,
+			// otherwise it goes over the block
+			if (currentDistance < 0.f || bestLength > currentDistance + ringDistances[k] + m_linkTolerance) {
+				if (currentDistance >= 0.f) {
+					finalPath.push_back(gmod::vector3<float>(current.x, totalHeight + 1.0f, current.z));
+				}
+				finalPath.push_back(gmod::vector3<float>(entry.x, totalHeight + 1.0f, entry.z));
+			}
+
+			for (size_t i = 0; i <= loop.size(); i++) {
+				const Point2& p = loop[(bestPoint + i) % loop.size()];
+				finalPath.push_back(gmod::vector3<float>(p.x, baseY, p.z));
+			}
+			current = entry;
+			currentDistance = ringDistances[k];
+		}
+	}
+
+	finalPath.push_back(gmod::vector3<float>(current.x, totalHeight + 1.0f, current.z));
+	finalPath.push_back(startPoint);
+	return finalPath;
+}
+
 std::vector<gmod::vector3<float>> StageTwo::GetFinalPath(const SegmentGraph& G, const SegmentEnd2& start, 
-	const std::vector<StageTwo::InterPoint>& offsetContour, int topContourIdx, float zTop) const {
+	const Contour& offsetContour, float zTop) const {
 
 	std::vector<int> path = G.SpecialDFS2(start.id);
 	
@@ -463,56 +642,47 @@ std::vector<gmod::vector3<float>> StageTwo::GetFinalPath(const SegmentGraph& G,
 		int fromId = path[v];
 		int toId = path[v + 1];
 
-		const auto& fromVertex = G.vertices2[fromId];
-		const auto& toVertex = G.vertices2[toId];
-
-		auto it = std::find_if(fromVertex.neighbours.begin(), fromVertex.neighbours.end(), [&toId](const std::pair<int, SegmentGraph::Edge2>& e) {
-			return e.first == toId;
-		});
-
-		if (it == fromVertex.neighbours.end()) {
+		const SegmentEnd2& fromVertex = G.vertices2[fromId];
+		const SegmentGraph::Edge2* edgePtr = G.FindEdge2(fromId, toId);
+		if (edgePtr == nullptr) {
 			throw std::runtime_error("There is an error in created path - edge not found.");
 		}
 
-		auto currPos = gmod::vector3<float>(fromVertex.segEnd.x, baseY, fromVertex.segEnd.z);
+		auto currPos = gmod::vector3<float>(fromVertex.x, baseY, fromVertex.z);
 		finalPath.push_back(currPos);
 
-		const auto& edge = it->second;
-		if (!edge.isVertical && !edge.isHorizontal) { // if we have contour edge, we need to add the points from contour
-			int start = edge.seg.interStartIdx;
-			int end = edge.seg.interEndIdx;
+		const auto& edge = *edgePtr;
+		if (!edge.isVertical && !edge.isHorizontal && edge.seg.interStartIdx != -1) { // if we have contour edge, we need to add the points from contour
+			size_t start = edge.seg.interStartIdx;
+			size_t end = edge.seg.interEndIdx;
 
-			auto& startPos = offsetContour[start].pos;
-			auto& endPos = offsetContour[end].pos;
+			auto startPos = ContourPos(offsetContour, start);
+			auto endPos = ContourPos(offsetContour, end);
 			// determine on which side of edge are we now
 			if ((currPos - startPos).length() > (currPos - endPos).length()) {
 				std::swap(start, end);
 			};
 
-			if (start < end) {
-				for (int j = start; j <= end; j++) {
-					finalPath.push_back(offsetContour[j].pos);
-				}
-			} else {
-				for (int j = start; j >= end; j--) {
-					finalPath.push_back(offsetContour[j].pos);
-				}
+			const auto range = start < end ? offsetContour.Forward(start, end) : offsetContour.Backward(start, end);
+			for (size_t j : range) {
+				finalPath.push_back(ContourPos(offsetContour, j));
 			}
 		} 
 	}
 
-	const SegmentEnd2& last = G.vertices2[path.back()].segEnd;
+	const SegmentEnd2& last = G.vertices2[path.back()];
 	finalPath.push_back(gmod::vector3<float>(last.x, baseY, last.z));
 	finalPath.push_back(gmod::vector3<float>(last.x, totalHeight + 1.0f, last.z));
 
-	// now go around contour
-	const auto& contourStart = offsetContour[topContourIdx].pos;
-	finalPath.push_back(gmod::vector3<float>(contourStart.x(), totalHeight + 1.0f, zTop));
-	finalPath.push_back(gmod::vector3<float>(contourStart.x(), baseY, zTop));
+	// now go around contour, starting from its top
+	const size_t topContourIdx = offsetContour.Extreme({ 0.f, -1.f });
+	const Point2& contourStart = offsetContour[topContourIdx];
+	finalPath.push_back(gmod::vector3<float>(contourStart.x, totalHeight + 1.0f, zTop));
+	finalPath.push_back(gmod::vector3<float>(contourStart.x, baseY, zTop));
 
-	for (int j = 0; j < offsetContour.size(); j++) {
-		int currIdx = (j + topContourIdx) % offsetContour.size();
-		finalPath.push_back(offsetContour[currIdx].pos);
+	const size_t n = offsetContour.Size();
+	for (size_t j : offsetContour.Forward(topContourIdx, (topContourIdx + n - 1) % n)) {
+		finalPath.push_back(ContourPos(offsetContour, j));
 	}
 
 	auto& back = finalPath.back();
@@ -522,6 +692,10 @@ std::vector<gmod::vector3<float>> StageTwo::GetFinalPath(const SegmentGraph& G,
 	return finalPath;
 }
 
+gmod::vector3<float> StageTwo::ContourPos(const Contour& contour, size_t k) const {
+	return gmod::vector3<float>(contour[k].x, baseY, contour[k].z);
+}
+
 bool StageTwo::IsOutside(const StageTwo::InterPoint& point, const std::vector<StageTwo::InterPoint>* contour) const {
 	int n = contour->size();
 	if (n < 3) { return 0; };
@@ -1,6 +1,9 @@
 #pragma once
 #include "Object.h"
+#include "Contour.h"
 #include "Intersection.h"
+#include "PlaneSection.h"
+#include "PolygonClipper.h"
 #include "SegmentGraph.h"
 #include <unordered_map>
 
@@ -24,7 +27,18 @@ namespace app {
 	private:
 		const float FZERO = 10.f * std::numeric_limits<float>::epsilon();
 		const float m_radius = 5.f;
+		const float m_contourOffset = 1.3f * m_radius;
+		// contour as the offset of the union of plane sections of the surfaces,
+		// otherwise, or when a section is open, their intersections with the base are offset and combined one by one
+		const bool m_usePolygonOffset = true;
+		const PlaneSection m_planeSection;
+		// offset rings of the area around the contour linked into one path, otherwise vertical zig-zag lines are used
+		const bool m_useSpiralPocketing = false;
+		// rounding of the offset rings allowed in the straight links between them
+		const float m_linkTolerance = 1e-2f;
 		const int m_expectedIntersections = 2;
+		// covers the tolerance of DoSegementsCross when looking for segments that may cross
+		const float m_gridMargin = 1e-3f;
 		
 		const Intersection::InterParams m_interParams = {
 			.gs = 1 * 1e-3,
@@ -77,12 +91,19 @@ namespace app {
 			float u, v;
 			const IGeometrical* surf;
 		};
-		std::vector<InterPoint> CreateOffsetContour(const std::vector<std::unique_ptr<Object>>& sceneObjects, Intersection& intersection) const;
+		std::vector<InterPoint> CreateOffsetContour(const std::vector<std::unique_ptr<Object>>& sceneObjects) const;
+		std::vector<InterPoint> PolygonOffsetContour(PolygonClipper::Paths sections) const;
+		std::vector<InterPoint> OffsetSurfaceContour(const std::vector<Intersection::PointOfIntersection>& pointsOfIntersection, const IGeometrical* surf) const;
 
 		void Combine(std::vector<StageTwo::InterPoint>& mainContour, const std::vector<StageTwo::InterPoint>& newContour) const;
 
+		std::vector<gmod::vector3<float>> SpiralPath(const Contour& offsetContour,
+			const Point2& minCorner, const Point2& maxCorner, float separation) const;
+
 		std::vector<gmod::vector3<float>> GetFinalPath(const SegmentGraph& G, const SegmentEnd2& start, 
-			const std::vector<StageTwo::InterPoint>& offsetContour, int topCountourIdx, float zTop) const;
+			const Contour& offsetContour, float zTop) const;
+		// contour point at the base
+		gmod::vector3<float> ContourPos(const Contour& contour, size_t k) const;
 
 		bool IsOutside(const StageTwo::InterPoint& point, const std::vector<StageTwo::InterPoint>* contour) const;
 
@@ -0,0 +1,130 @@
+#include "StockModel.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace app;
+
+StockModel::StockModel(float minX, float minZ, float width, float length, float height, int resolution) :
+	m_height(height), m_heights(resolution, resolution, minX, minZ, width, length, height) {}
+
+template<typename F>
+void StockModel::ForEachTouched(const gmod::vector3<float>& from, const gmod::vector3<float>& to, const Tool& tool, F&& func) const {
+	const float R = tool.radius;
+
+	const int x0 = std::max(0, static_cast<int>(std::floor((std::min(from.x(), to.x()) - R - m_heights.MinX()) / m_heights.StepX())));
+	const int x1 = std::min(m_heights.ResX(), static_cast<int>(std::ceil((std::max(from.x(), to.x()) + R - m_heights.MinX()) / m_heights.StepX())));
+	const int z0 = std::max(0, static_cast<int>(std::floor((std::min(from.z(), to.z()) - R - m_heights.MinZ()) / m_heights.StepZ())));
+	const int z1 = std::min(m_heights.ResZ(), static_cast<int>(std::ceil((std::max(from.z(), to.z()) + R - m_heights.MinZ()) / m_heights.StepZ())));
+
+	const gmod::vector3<float> AB = to - from;
+	const float lengthSq = AB.x() * AB.x() + AB.y() * AB.y() + AB.z() * AB.z();
+
+	for (int x = x0; x <= x1; x++) {
+		const float px = m_heights.X(x);
+		for (int z = z0; z <= z1; z++) {
+			const float pz = m_heights.Z(z);
+			const float py = m_heights.At(x, z);
+
+			// closest position of the tool to the sample, same as toolPos in the shader
+			float t = 0.f;
+			if (lengthSq > 0.f) {
+				t = std::clamp(((px - from.x()) * AB.x() + (py - from.y()) * AB.y() + (pz - from.z()) * AB.z()) / lengthSq, 0.f, 1.f);
+			}
+			const float tipX = from.x() + t * AB.x();
+			const float tipY = from.y() + t * AB.y();
+			const float tipZ = from.z() + t * AB.z();
+
+			const float dx = px - tipX;
+			const float dz = pz - tipZ;
+			const float distSqXZ = dx * dx + dz * dz;
+			if (distSqXZ > R * R) { continue; }
+
+			if (tool.type == CutterType::Cylindrical) {
+				if (py >= tipY) {
+					func(x, z, tipY);
+				}
+				continue;
+			}
+
+			const float centreY = tipY + R;
+			const float dy = py - centreY;
+			if (py >= centreY || distSqXZ + dy * dy <= R * R) {
+				func(x, z, centreY - std::sqrt(R * R - distSqXZ));
+			}
+		}
+	}
+}
+
+void StockModel::Reset() {
+	std::fill(m_heights.Data().begin(), m_heights.Data().end(), m_height);
+}
+
+void StockModel::Apply(const std::vector<gmod::vector3<float>>& path, const Tool& tool) {
+	for (size_t i = 1; i < path.size(); i++) {
+		Cut(path[i - 1], path[i], tool);
+	}
+}
+
+std::vector<gmod::vector3<float>> StockModel::Shorten(const std::vector<gmod::vector3<float>>& path, const Tool& tool) {
+	if (path.size() < 2) { return path; }
+
+	std::vector<gmod::vector3<float>> shortened;
+	shortened.push_back(path.front());
+
+	const int n = static_cast<int>(path.size());
+	int i = 0;
+	while (i < n - 1) {
+		// moves from i to last do not remove any material
+		int last = i;
+		while (last + 1 < n && !Cuts(path[last], path[last + 1], tool, m_cutTolerance)) {
+			last++;
+		}
+
+		if (last == i) {
+			Cut(path[i], path[i + 1], tool);
+			shortened.push_back(path[i + 1]);
+			i++;
+			continue;
+		}
+
+		// furthest point of the run reachable directly, the first move of the run is always kept as a fallback
+		int reachable = i + 1;
+		if (!Cuts(path[i], path[last], tool, -m_clearance)) {
+			reachable = last;
+		} else {
+			int unreachable = last;
+			while (unreachable - reachable > 1) {
+				const int mid = (reachable + unreachable) / 2;
+				if (Cuts(path[i], path[mid], tool, -m_clearance)) {
+					unreachable = mid;
+				} else {
+					reachable = mid;
+				}
+			}
+		}
+
+		shortened.push_back(path[reachable]);
+		i = reachable;
+	}
+
+	return shortened;
+}
+
+bool StockModel::Cuts(const gmod::vector3<float>& from, const gmod::vector3<float>& to, const Tool& tool, float tolerance) const {
+	bool cuts = false;
+	ForEachTouched(from, to, tool, [&](int x, int z, float newHeight) {
+		if (newHeight < m_heights.At(x, z) - tolerance) {
+			cuts = true;
+		}
+	});
+	return cuts;
+}
+
+void StockModel::Cut(const gmod::vector3<float>& from, const gmod::vector3<float>& to, const Tool& tool) {
+	ForEachTouched(from, to, tool, [&](int x, int z, float newHeight) {
+		float& h = m_heights.At(x, z);
+		if (newHeight < h) {
+			h = std::max(newHeight, 0.f);
+		}
+	});
+}
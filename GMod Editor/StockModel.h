@@ -0,0 +1,42 @@
+#pragma once
+#include "../gmod/vector3.h"
+#include "CutterType.h"
+#include "Heightmap.h"
+#include <vector>
+
+namespace app {
+	// CPU copy of the milled stock, cut with the same cutter geometry as cs_milling.hlsl
+	// positions are tool tips in scene coordinates, stock lies on y = 0
+	class StockModel {
+	public:
+		struct Tool {
+			CutterType type;
+			float radius;
+		};
+
+		StockModel(float minX = -75.f, float minZ = -75.f, float width = 150.f, float length = 150.f, float height = 50.f, int resolution = 600);
+
+		void Reset();
+		// removes material along the whole path
+		void Apply(const std::vector<gmod::vector3<float>>& path, const Tool& tool);
+		// replaces runs of moves removing no material by direct moves staying clear of the stock, then applies the result
+		std::vector<gmod::vector3<float>> Shorten(const std::vector<gmod::vector3<float>>& path, const Tool& tool);
+
+		inline const Heightmap& Heights() const { return m_heights; }
+	private:
+		// lowering the stock by less is not considered cutting
+		const float m_cutTolerance = 0.01f;
+		// distance direct moves keep from the stock, covers the resolution of the model
+		const float m_clearance = 0.5f;
+
+		float m_height;
+		Heightmap m_heights;
+
+		// checks whether the move lowers any sample by more than the tolerance, negative tolerance works as clearance
+		bool Cuts(const gmod::vector3<float>& from, const gmod::vector3<float>& to, const Tool& tool, float tolerance) const;
+		void Cut(const gmod::vector3<float>& from, const gmod::vector3<float>& to, const Tool& tool);
+		// calls func(x, z, newHeight) for every sample touched by the move
+		template<typename F>
+		void ForEachTouched(const gmod::vector3<float>& from, const gmod::vector3<float>& to, const Tool& tool, F&& func) const;
+	};
+}
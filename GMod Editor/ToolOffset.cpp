@@ -0,0 +1,219 @@
+#include "ToolOffset.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using namespace app;
+
+Heightmap ToolOffset::Dilate(const Heightmap& heightmap, const Tool& tool) const {
+	if (tool.cornerRadius <= 0.f) {
+		return FlatDilate(heightmap, tool.radius);
+	}
+	return RoundDilate(heightmap, { tool.radius, std::min(tool.cornerRadius, tool.radius) });
+}
+
+Heightmap ToolOffset::SquareDilate(const Heightmap& heightmap, int halfX, int halfZ) const {
+	const int sizeX = heightmap.ResX() + 1;
+	const int sizeZ = heightmap.ResZ() + 1;
+
+	Heightmap alongZ = heightmap;
+	Parallel::For(0, sizeX, [&](int x) {
+		SlidingMax(&heightmap.Data()[x * sizeZ], &alongZ.Data()[x * sizeZ], sizeZ, 1, halfZ);
+	});
+
+	Heightmap result = alongZ;
+	Parallel::For(0, sizeZ, [&](int z) {
+		SlidingMax(&alongZ.Data()[z], &result.Data()[z], sizeX, sizeZ, halfX);
+	});
+
+	return result;
+}
+
+template<typename Kernel, typename Crossing>
+void ToolOffset::Envelope(const float* in, float* out, int count, float step, float reach, Kernel kernel, Crossing crossing) const {
+	const float lowest = std::numeric_limits<float>::lowest();
+
+	auto value = [&](int c, float z) {
+		const float dz = z - c * step;
+		return std::abs(dz) > reach ? lowest : in[c] + kernel(dz);
+	};
+
+	// to the left of the returned position the copy centred at a is higher, to the right the one at b
+	auto split = [&](int a, int b) {
+		const float ca = a * step;
+		const float cb = b * step;
+		const float left = cb - reach;
+		const float right = ca + reach;
+		if (left > right) {
+			return (left + right) / 2;
+		}
+		// both copies are evaluated without the support test, the ends of the overlap may round outside of it
+		if (in[a] + kernel(left - ca) <= in[b] + kernel(left - cb)) {
+			return left;
+		}
+		if (in[a] + kernel(right - ca) >= in[b] + kernel(right - cb)) {
+			return right;
+		}
+		return crossing(ca, in[a], cb, in[b], left, right);
+	};
+
+	// copy centred at centres[k] is on top between bounds[k] and bounds[k + 1]
+	std::vector<int> centres(count);
+	std::vector<float> bounds(count + 1);
+	int k = 0;
+	centres[0] = 0;
+	bounds[0] = lowest;
+	bounds[1] = std::numeric_limits<float>::max();
+
+	for (int q = 1; q < count; q++) {
+		float s = split(centres[k], q);
+		while (s <= bounds[k]) {
+			k--;
+			s = split(centres[k], q);
+		}
+		k++;
+		centres[k] = q;
+		bounds[k] = s;
+		bounds[k + 1] = std::numeric_limits<float>::max();
+	}
+
+	k = 0;
+	for (int i = 0; i < count; i++) {
+		const float z = i * step;
+		while (bounds[k + 1] < z) {
+			k++;
+		}
+		out[i] = value(centres[k], z);
+	}
+}
+
+Heightmap ToolOffset::FlatDilate(const Heightmap& heightmap, float radius) const {
+	const int sizeX = heightmap.ResX() + 1;
+	const int sizeZ = heightmap.ResZ() + 1;
+	const float stepX = heightmap.StepX();
+	const float stepZ = heightmap.StepZ();
+	const int rangeX = static_cast<int>((radius + m_boundaryEps) / stepX);
+
+	// the disk is a union of chords along z, one for every column offset
+	// chords of the columns x - d and x + d have equal lengths and share one sliding max
+	Heightmap result = heightmap;
+	Heightmap chords = heightmap;
+	for (int d = 0; d <= rangeX; d++) {
+		const float dx = d * stepX;
+		const int half = static_cast<int>((std::sqrt(std::max(0.f, radius * radius - dx * dx)) + m_boundaryEps) / stepZ);
+
+		Parallel::For(0, sizeX, [&](int x) {
+			SlidingMax(&heightmap.Data()[x * sizeZ], &chords.Data()[x * sizeZ], sizeZ, 1, half);
+		});
+		Parallel::For(0, sizeX, [&](int x) {
+			for (int neighbour : { x - d, x + d }) {
+				if (neighbour < 0 || neighbour >= sizeX) { continue; }
+				for (int z = 0; z < sizeZ; z++) {
+					result.At(x, z) = std::max(result.At(x, z), chords.At(neighbour, z));
+				}
+			}
+		});
+	}
+
+	return result;
+}
+
+Heightmap ToolOffset::RoundDilate(const Heightmap& heightmap, const Tool& tool) const {
+	const int sizeX = heightmap.ResX() + 1;
+	const int sizeZ = heightmap.ResZ() + 1;
+	const float stepX = heightmap.StepX();
+	const float stepZ = heightmap.StepZ();
+	const int rangeX = static_cast<int>((tool.radius + m_boundaryEps) / stepX);
+
+	const float radius = tool.radius;
+	const float corner = tool.cornerRadius;
+	const float flat = radius - corner; // radius of the flat part of the bottom, 0 for ball end mills
+
+	// the tool is a union of its sections by planes of constant x, one for every column offset
+	// every section is concave, so the columns are dilated by upper envelopes of its copies
+	// tip height is the highest position touching the surface, the kernel is measured from the corner centres
+	Heightmap result = heightmap;
+	std::fill(result.Data().begin(), result.Data().end(), std::numeric_limits<float>::lowest());
+	Heightmap sections = heightmap;
+	for (int d = 0; d <= rangeX; d++) {
+		const float dx = d * stepX;
+		const float reach = std::sqrt(std::max(0.f, radius * radius - dx * dx)) + m_boundaryEps;
+
+		if (flat <= 0.f) {
+			// sections of a ball are circles, their upper arcs cross where the circles do
+			const float r2 = std::max(0.f, radius * radius - dx * dx);
+			auto kernel = [r2](float dz) {
+				return std::sqrt(std::max(0.f, r2 - dz * dz));
+			};
+			auto crossing = [r2](float ca, float ha, float cb, float hb, float, float) {
+				const float dc = cb - ca;
+				const float dh = hb - ha;
+				const float dist = std::sqrt(dc * dc + dh * dh);
+				const float h = std::sqrt(std::max(0.f, r2 - dist * dist / 4));
+				return (ca + cb) / 2 - dh / dist * h;
+			};
+			Parallel::For(0, sizeX, [&](int x) {
+				Envelope(&heightmap.Data()[x * sizeZ], &sections.Data()[x * sizeZ], sizeZ, stepZ, reach, kernel, crossing);
+			});
+		} else {
+			auto kernel = [dx, flat, corner](float dz) {
+				const float e = std::max(0.f, std::sqrt(dx * dx + dz * dz) - flat);
+				return std::sqrt(std::max(0.f, corner * corner - e * e));
+			};
+			// difference of the copies is decreasing, bisect for its root
+			auto crossing = [&kernel](float ca, float ha, float cb, float hb, float left, float right) {
+				for (int i = 0; i < 30; i++) {
+					const float mid = (left + right) / 2;
+					if (ha + kernel(mid - ca) > hb + kernel(mid - cb)) {
+						left = mid;
+					} else {
+						right = mid;
+					}
+				}
+				return (left + right) / 2;
+			};
+			Parallel::For(0, sizeX, [&](int x) {
+				Envelope(&heightmap.Data()[x * sizeZ], &sections.Data()[x * sizeZ], sizeZ, stepZ, reach, kernel, crossing);
+			});
+		}
+
+		Parallel::For(0, sizeX, [&](int x) {
+			for (int neighbour : { x - d, x + d }) {
+				if (neighbour < 0 || neighbour >= sizeX) { continue; }
+				for (int z = 0; z < sizeZ; z++) {
+					result.At(x, z) = std::max(result.At(x, z), sections.At(neighbour, z));
+				}
+			}
+		});
+	}
+
+	for (auto& h : result.Data()) {
+		h -= corner;
+	}
+
+	return result;
+}
+
+void ToolOffset::SlidingMax(const float* in, float* out, int count, int stride, int half) const {
+	// indices of decreasing values, front is the max of the current window
+	std::vector<int> window(count);
+	int head = 0;
+	int tail = 0;
+	int next = 0;
+
+	for (int i = 0; i < count; i++) {
+		const int last = std::min(count - 1, i + half);
+		for (; next <= last; next++) {
+			while (tail > head && in[window[tail - 1] * stride] <= in[next * stride]) {
+				tail--;
+			}
+			window[tail++] = next;
+		}
+		while (window[head] < i - half) {
+			head++;
+		}
+		out[i * stride] = in[window[head] * stride];
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "Heightmap.h"
+
+namespace app {
+	// turns heightmaps of the model into heightmaps of the tool tip (cutter location surfaces)
+	class ToolOffset {
+	public:
+		struct Tool {
+			float radius;
+			float cornerRadius; // 0 for flat end mills, radius for ball end mills, anything between for bull-nose
+		};
+
+		// lowest tip height for every sample at which the tool does not cut below the heightmap
+		Heightmap Dilate(const Heightmap& heightmap, const Tool& tool) const;
+		// max over a window of (2 * halfX + 1) x (2 * halfZ + 1) samples, done as two separable passes
+		Heightmap SquareDilate(const Heightmap& heightmap, int halfX, int halfZ) const;
+	private:
+		// samples lying exactly at the tool radius are still touched despite rounding
+		const float m_boundaryEps = 1e-3f;
+
+		Heightmap FlatDilate(const Heightmap& heightmap, float radius) const;
+		Heightmap RoundDilate(const Heightmap& heightmap, const Tool& tool) const;
+
+		// max over [i - half, i + half] for every i, elements are stride floats apart
+		void SlidingMax(const float* in, float* out, int count, int stride, int half) const;
+		// max over j of in[j] + kernel((i - j) * step) for every i, samples are contiguous
+		// kernel has to be concave on [-reach, reach], so its copies centred at different samples cross at most once
+		// crossing(ca, ha, cb, hb) returns the crossing of copies known to cross inside their common support
+		template<typename Kernel, typename Crossing>
+		void Envelope(const float* in, float* out, int count, float step, float reach, Kernel kernel, Crossing crossing) const;
+	};
+}
@@ -7,10 +7,14 @@
 #include "Polyline.h"
 #include "Spline.h"
 #include "Gregory.h"
+#include "GougeChecker.h"
 #include "tinyfiledialogs.h"
 #include "Torus.h"
 #include "UI.h"
+#include <filesystem>
 #include <fstream>
+#include <iomanip>
+#include <sstream>
 #include <unordered_set>
 
 using namespace app;
@@ -842,15 +846,21 @@ void UI::RenderIO_CAD() {
 			m_generatedFlag = true;
 			switch (generatedMillingStage) {
 				case 1: {
-					parser.Save(m_stageOne.GeneratePath(sceneObjects, intersection), m_stageOne.stage, m_stageOne.type, std::to_string(m_stageOne.diameter));
+					auto path = m_stageOne.GeneratePath(sceneObjects, intersection);
+					UpdateStock(1, path, { CutterType::Spherical, m_stageOne.diameter / 2.f }, false);
+					parser.Save(path, m_stageOne.stage, m_stageOne.type, std::to_string(m_stageOne.diameter));
 					break;
 				}
 				case 2: {
-					parser.Save(m_stageTwo.GeneratePath(sceneObjects, intersection), m_stageTwo.stage, m_stageTwo.type, std::to_string(m_stageTwo.diameter));
+					auto path = m_stageTwo.GeneratePath(sceneObjects, intersection);
+					path = UpdateStock(2, path, { CutterType::Cylindrical, m_stageTwo.diameter / 2.f }, true);
+					parser.Save(path, m_stageTwo.stage, m_stageTwo.type, std::to_string(m_stageTwo.diameter));
 					break;
 				}
 				case 3: {
-					parser.Save(m_stageThree.GeneratePath(sceneObjects, intersection), m_stageThree.stage, m_stageThree.type, std::to_string(m_stageThree.diameter));
+					auto path = m_stageThree.GeneratePath(sceneObjects, intersection);
+					path = UpdateStock(3, path, { CutterType::Spherical, m_stageThree.diameter / 2.f }, true);
+					parser.Save(path, m_stageThree.stage, m_stageThree.type, std::to_string(m_stageThree.diameter));
 					break;
 				}
 				case 4: {
@@ -872,10 +882,49 @@ void UI::RenderIO_CAD() {
 				ImGui::TextColored(ImVec4(1, 0, 0, 1), "Invalid stage.");
 			}
 		}
+
+		if (ImGui::Button("Sweep stage 3", ImVec2(120.f, 0.f))) {
+			SweepStageThree();
+		}
+		if (!m_sweepInfo.empty()) {
+			ImGui::SameLine();
+			ImGui::Text(m_sweepInfo.c_str());
+		}
 	}
 	ImGui::End();
 }
 
+void UI::SweepStageThree() {
+	const auto results = m_stageThree.Sweep(sceneObjects, m_stageThree.sweepRanges);
+
+	std::filesystem::path filePath = std::filesystem::current_path() / (m_stageThree.stage + ".sweep.txt");
+	std::ofstream file(filePath);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to create file for writing: " + filePath.string());
+	}
+	file << m_stageThree.SweepReport(results);
+
+	int succeeded = std::count_if(results.begin(), results.end(), [](const StageThree::SweepResult& r) { return r.success; });
+	m_sweepInfo = std::to_string(succeeded) + "/" + std::to_string(results.size()) + " succeeded, report in " + filePath.filename().string();
+}
+
+std::vector<gmod::vector3<float>> UI::UpdateStock(int stage, const std::vector<gmod::vector3<float>>& path, const StockModel::Tool& tool, bool shorten) {
+	// start from the stock left by the closest earlier stage, later ones are no longer valid
+	auto next = m_stockAfterStage.lower_bound(stage);
+	StockModel stock = next == m_stockAfterStage.begin() ? StockModel() : std::prev(next)->second;
+	m_stockAfterStage.erase(next, m_stockAfterStage.end());
+
+	std::vector<gmod::vector3<float>> result = path;
+	if (shorten) {
+		result = stock.Shorten(path, tool);
+	} else {
+		stock.Apply(path, tool);
+	}
+
+	m_stockAfterStage.emplace(stage, std::move(stock));
+	return result;
+}
+
 void UI::RenderIO_CAM() {
 	ImGuiViewport* viewport = ImGui::GetMainViewport();
 	ImGui::SetNextWindowPos(ImVec2(0.f, viewport->Size.y - 35.f), ImGuiCond_Always);
@@ -903,6 +952,14 @@ void UI::RenderIO_CAM() {
 	}
 	ImGui::SameLine();
 	ImGui::TextColored(ImVec4(1.f, 1.f, 1.f, 1.f), "Length: %.1f [cm]", parser.pathLength);
+	ImGui::SameLine();
+	if (ImGui::Button("Check gouges", ImVec2(150.f, 0.f))) {
+		CheckGouges();
+	}
+	if (!m_gougeInfo.empty()) {
+		ImGui::SameLine();
+		ImGui::TextColored(m_gougeInfoColor, m_gougeInfo.c_str());
+	}
 	if (animator.errorDetected) {
 		ImGui::SameLine();
 		ImGui::TextColored(ImVec4(1.f, 0.f, 0.f, 1.f), animator.errorMsg.c_str());
@@ -910,6 +967,43 @@ void UI::RenderIO_CAM() {
 	ImGui::End();
 }
 
+void UI::CheckGouges() {
+	if (parser.Empty()) {
+		m_gougeInfo = "No path loaded.";
+		m_gougeInfoColor = { 1.f, 1.f, 1.f, 1.f };
+		return;
+	}
+	if (milling.cutter.GetCutterType() != CutterType::Spherical) {
+		m_gougeInfo = "Gouges are checked for spherical cutters only.";
+		m_gougeInfoColor = { 1.f, 1.f, 1.f, 1.f };
+		return;
+	}
+
+	std::vector<const IGeometrical*> surfaces;
+	for (const auto& so : sceneObjects) {
+		const IGeometrical* g = dynamic_cast<const IGeometrical*>(so.get());
+		if (g != nullptr) {
+			surfaces.push_back(g);
+		}
+	}
+
+	const GougeChecker checker(surfaces);
+	const auto gouges = checker.Check(parser.Commands(), milling.cutter.GetRadius());
+	if (gouges.empty()) {
+		m_gougeInfo = "No gouges.";
+		m_gougeInfoColor = { 0.f, 1.f, 0.f, 1.f };
+	} else {
+		auto deepest = std::max_element(gouges.begin(), gouges.end(), [](const GougeChecker::Gouge& a, const GougeChecker::Gouge& b) {
+			return a.depth < b.depth;
+		});
+		std::ostringstream info;
+		info << "Gouges: " << gouges.size() << ", first at line " << gouges.front().lineNumber
+			<< ", deepest " << std::fixed << std::setprecision(3) << deepest->depth << " at line " << deepest->lineNumber;
+		m_gougeInfo = info.str();
+		m_gougeInfoColor = { 1.f, 0.f, 0.f, 1.f };
+	}
+}
+
 std::string UI::OpenFileDialog_CAD() {
 	char const* filters[1] = { "*.json" };
 	char const* file = tinyfd_openFileDialog(
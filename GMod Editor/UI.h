@@ -16,6 +16,8 @@
 #include "StageThree.h"
 #include <memory>
 #include "StageFour.h"
+#include "StockModel.h"
+#include <map>
 
 namespace app {
 	class Application;
@@ -104,6 +106,16 @@ namespace app {
 		StageTwo m_stageTwo;
 		StageThree m_stageThree;
 		StageFour m_stageFour;
+		// stock left after every stage generated in this session
+		std::map<int, StockModel> m_stockAfterStage;
+		std::vector<gmod::vector3<float>> UpdateStock(int stage, const std::vector<gmod::vector3<float>>& path, const StockModel::Tool& tool, bool shorten);
+
+		std::string m_sweepInfo = "";
+		void SweepStageThree();
+
+		std::string m_gougeInfo = "";
+		ImVec4 m_gougeInfoColor = { 1.f, 1.f, 1.f, 1.f };
+		void CheckGouges();
 
 		int m_lastSelectedIndex = -1;
 